@@ -1,6 +1,6 @@
 #!/bin/sh
 gcc \
 	src/* \
-	-Wall -Wextra -std=c99 -pedantic \
+	-Wall -Wextra -std=c99 -pedantic -pthread \
 	-g -fsanitize=address -fsanitize=undefined \
 	-o freecell
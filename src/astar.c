@@ -0,0 +1,154 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "astar.h"
+#include "board.h"
+#include "bucketq.h"
+#include "fpset.h"
+#include "freecell.h"
+#include "heuristic.h"
+#include "stats.h"
+#include "strategy.h"
+
+
+void nodes_init(Nodes *nodes) {
+	nodes->nodes = NULL;
+	nodes->len = 0;
+	nodes->capacity = 0;
+}
+
+void nodes_destroy(Nodes *nodes) {
+	free(nodes->nodes);
+	nodes_init(nodes);
+}
+
+static Node* nodes_next(Nodes *nodes) {
+	if (nodes->len == nodes->capacity) {
+		nodes->capacity = nodes->capacity ? nodes->capacity * 2 : 1 << 16;
+		nodes->nodes = (Node*)realloc(nodes->nodes, nodes->capacity * sizeof(Node));
+		assert(nodes->nodes != NULL);
+	}
+	return &nodes->nodes[nodes->len];
+}
+
+/**
+ * Save the board as a new node, returns its index.
+ */
+uint32_t nodes_push(Nodes *nodes, Board *board, uint32_t parent, int g) {
+	Node *node;
+
+	node = nodes_next(nodes);
+	board_pack(board, node->packed);
+	node->parent = parent;
+	node->g = g;
+	return nodes->len++;
+}
+
+/**
+ * Save a copy of a node, returns its index.
+ */
+uint32_t nodes_copy(Nodes *nodes, Node *node) {
+	*nodes_next(nodes) = *node;
+	return nodes->len++;
+}
+
+/**
+ * Replay the path from the root node to the last one in the frames, one
+ * goal per node. The moves are not saved in the nodes, the children of
+ * each node are generated again until the next node is found with the
+ * same number of moves. The board is left on the last node.
+ */
+void nodes_path(Nodes *nodes, uint32_t last, Board *board, Frames *frames) {
+	uint32_t id, *path;
+	int len, i;
+	enum strat strat;
+	Goal *goal;
+
+	for (len = 1, id = last; nodes->nodes[id].parent != id; id = nodes->nodes[id].parent, len++);
+	path = (uint32_t*)malloc(len * sizeof(uint32_t));
+	assert(path != NULL);
+	for (i = len - 1, id = last; i >= 0; id = nodes->nodes[id].parent, i--)
+		path[i] = id;
+
+	board_unpack(board, nodes->nodes[path[0]].packed);
+	for (i = 1; i < len; i++) {
+		compute_properties(board);
+		goal = frames_push(frames);
+		for (;;) {
+			strat = strat_next(board, goal);
+			assert(strat != STRAT_NULL);
+			if (!memcmp(board->location + 1, nodes->nodes[path[i]].packed, 52)
+					&& frames->journal.len == nodes->nodes[path[i]].g) break;
+			journal_undo(goal->journal, board, goal->start);
+			compute_properties(board);
+		}
+	}
+	free(path);
+}
+
+/**
+ * Best-first search using f = g + weight * h, g being the number of moves
+ * played from the initial board. With a weight of 1 and no pattern
+ * database the solution is the shortest among the moves the strategies
+ * generate, not among every legal move. Higher weights find longer
+ * solutions faster. The boards are kept packed with a link to their
+ * parent, the path is rebuilt in the frames once the game is won. The search gives up after
+ * budget expanded boards (0 for no limit).
+ */
+bool astar(Board *board, Frames *frames, double weight, unsigned long budget) {
+	uint32_t id;
+	int g;
+	bool won;
+	Nodes nodes;
+	Goal goal;
+	Journal journal;
+	BucketQ *open;
+	FpSet *closed;
+
+	nodes_init(&nodes);
+	journal_init(&journal);
+	bucketq_new(&open);
+	fpset_new(&closed, 1 << 16);
+
+	id = nodes_push(&nodes, board, 0, 0);
+	bucketq_push(open, (int) (weight * estimate(board)), id);
+
+	won = false;
+	while ((!budget || stats.visited < budget) && bucketq_pop(open, &id)) {
+		board_unpack(board, nodes.nodes[id].packed);
+		stats.nodes++;
+
+		// Another path already expanded this board
+		if (!fpset_add(closed, board->hash)) continue;
+		stats.visited++;
+
+		if (is_game_won(board)) {
+			won = true;
+			break;
+		}
+
+		// Open all the children not expanded yet
+		compute_properties(board);
+		g = nodes.nodes[id].g;
+		goal.journal = &journal;
+		goal.start = 0;
+		goal.strat = STRAT_NULL;
+		while (strat_next(board, &goal) != STRAT_NULL) {
+			if (!fpset_contains(closed, board->hash))
+				bucketq_push(open, g + journal.len + (int) (weight * estimate(board)),
+						nodes_push(&nodes, board, id, g + journal.len));
+			journal_undo(&journal, board, 0);
+			compute_properties(board);
+		}
+	}
+
+	stats.states = nodes.len;
+	if (won) nodes_path(&nodes, id, board, frames);
+	else board_unpack(board, nodes.nodes[0].packed);
+
+	fpset_destroy(closed);
+	bucketq_destroy(open);
+	journal_destroy(&journal);
+	nodes_destroy(&nodes);
+	return won;
+}
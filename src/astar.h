@@ -0,0 +1,36 @@
+#ifndef FREECELL_ASTAR_H
+#define FREECELL_ASTAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
+#include "freecell.h"
+
+/**
+ * A board kept in the A* open list, its parent is the index of the node
+ * it was generated from, the root is its own parent.
+ */
+typedef struct node {
+	uint8_t packed[52];
+	uint32_t parent;
+	uint16_t g;
+} Node;
+
+/**
+ * Growable array of all the nodes generated by the search.
+ */
+typedef struct nodes {
+	Node *nodes;
+	uint32_t len;
+	uint32_t capacity;
+} Nodes;
+
+void nodes_init(Nodes *nodes);
+void nodes_destroy(Nodes *nodes);
+uint32_t nodes_push(Nodes *nodes, Board *board, uint32_t parent, int g);
+uint32_t nodes_copy(Nodes *nodes, Node *node);
+void nodes_path(Nodes *nodes, uint32_t last, Board *board, Frames *frames);
+
+bool astar(Board *board, Frames *frames, double weight, unsigned long budget);
+
+#endif
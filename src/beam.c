@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "astar.h"
+#include "beam.h"
+#include "board.h"
+#include "fpset.h"
+#include "freecell.h"
+#include "heuristic.h"
+#include "stats.h"
+#include "strategy.h"
+
+/**
+ * A child of the layer with its f value and its fingerprint.
+ */
+typedef struct scored {
+	int f;
+	uint32_t id;
+	uint64_t hash;
+} Scored;
+
+int comp_scored(const void *p1, const void *p2) {
+	const Scored *s1, *s2;
+
+	s1 = (const Scored*) p1;
+	s2 = (const Scored*) p2;
+
+	if (s1->f != s2->f)
+		return s1->f > s2->f ? 1 : -1;
+	if (s1->id != s2->id)
+		return s1->id > s2->id ? 1 : -1;
+	return 0;
+}
+
+/**
+ * Breadth-first search keeping only the width best boards, by
+ * f = g + weight * h, of each layer. The search fails when a layer is
+ * empty or after budget expanded boards (0 for no limit).
+ */
+bool beam(Board *board, Frames *frames, int width, double weight, unsigned long budget) {
+	uint32_t id, child, first, last, winner;
+	int g, i, scored_capacity;
+	Nodes nodes, children;
+	Scored *scored;
+	Goal goal;
+	Journal journal;
+	FpSet *seen;
+
+	nodes_init(&nodes);
+	nodes_init(&children);
+	journal_init(&journal);
+	fpset_new(&seen, 1 << 16);
+	scored = NULL;
+	scored_capacity = 0;
+
+	winner = UINT32_MAX;
+	nodes_push(&nodes, board, 0, 0);
+	fpset_add(seen, board->hash);
+	if (is_game_won(board)) winner = 0;
+
+	first = 0;
+	last = 1;
+	while (winner == UINT32_MAX && first < last) {
+
+		// Generate the children of the whole layer
+		children.len = 0;
+		for (id = first; winner == UINT32_MAX && id < last; id++) {
+			if (budget && stats.visited >= budget) break;
+			board_unpack(board, nodes.nodes[id].packed);
+			compute_properties(board);
+			stats.nodes++;
+			stats.visited++;
+
+			g = nodes.nodes[id].g;
+			goal.journal = &journal;
+			goal.start = 0;
+			goal.strat = STRAT_NULL;
+			while (strat_next(board, &goal) != STRAT_NULL) {
+				if (is_game_won(board)) {
+					winner = nodes_push(&nodes, board, id, g + journal.len);
+					break;
+				}
+				if (!fpset_contains(seen, board->hash)) {
+					if ((int) children.len == scored_capacity) {
+						scored_capacity = scored_capacity ? scored_capacity * 2 : 1024;
+						scored = (Scored*)realloc(scored, scored_capacity * sizeof(Scored));
+						assert(scored != NULL);
+					}
+					child = nodes_push(&children, board, id, g + journal.len);
+					scored[child].f = g + journal.len + (int) (weight * estimate(board));
+					scored[child].hash = board->hash;
+					scored[child].id = child;
+				}
+				journal_undo(&journal, board, 0);
+				compute_properties(board);
+			}
+		}
+		if (winner != UINT32_MAX || id < last) break;
+
+		// Keep the best children as the next layer
+		qsort(scored, children.len, sizeof(Scored), comp_scored);
+		first = last;
+		for (i = 0; i < (int) children.len && (int) (nodes.len - first) < width; i++) {
+			if (!fpset_add(seen, scored[i].hash)) continue;
+			nodes_copy(&nodes, &children.nodes[scored[i].id]);
+		}
+		last = nodes.len;
+	}
+
+	stats.states = nodes.len;
+	if (winner != UINT32_MAX) nodes_path(&nodes, winner, board, frames);
+	else board_unpack(board, nodes.nodes[0].packed);
+
+	free(scored);
+	fpset_destroy(seen);
+	journal_destroy(&journal);
+	nodes_destroy(&children);
+	nodes_destroy(&nodes);
+	return winner != UINT32_MAX;
+}
@@ -0,0 +1,10 @@
+#ifndef FREECELL_BEAM_H
+#define FREECELL_BEAM_H
+
+#include <stdbool.h>
+#include "board.h"
+#include "freecell.h"
+
+bool beam(Board *board, Frames *frames, int width, double weight, unsigned long budget);
+
+#endif
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+#include "board.h"
+#include "fpset.h"
+#include "freecell.h"
+#include "movegen.h"
+
+// Calls to the measured function
+#define BENCH_CALLS 1000000
+
+// Fingerprints claimed by all the threads together, the ones of each
+// thread are half shared with the next thread
+#define BENCH_CLAIMS (1 << 22)
+
+/**
+ * Fingerprints a thread claims in the shared set.
+ */
+typedef struct claimer {
+	FpSet *set;
+	uint64_t first;
+	uint64_t count;
+	unsigned long claimed;
+	pthread_t thread;
+} Claimer;
+
+static double bench_elapsed(struct timespec *start) {
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Solve the board with the depth-first search and save a copy of every
+ * board met along the solution, the board is restored afterward.
+ * Returns the number of copies.
+ */
+static int bench_samples(Board *board, Board **samples) {
+	int len, i;
+	bool won;
+	Move m;
+	Frames frames;
+	FpSet *visited;
+
+	frames_init(&frames);
+	fpset_new(&visited, 1 << 16);
+	won = search(board, visited, &frames);
+	assert(won);
+
+	len = 0;
+	*samples = (Board*)malloc((frames.journal.len + 1) * sizeof(Board));
+	assert(*samples != NULL);
+	(*samples)[len++] = *board;
+	while (frames.journal.len) {
+		m = frames.journal.moves[--frames.journal.len];
+		move(board, (Card*) board + MOVE_TO(m), (Card*) board + MOVE_FROM(m));
+		(*samples)[len++] = *board;
+	}
+	for (i = 0; i < len; i++) {
+		(*samples)[i].dirty = 0xFF;
+		compute_properties(&(*samples)[i]);
+	}
+	compute_properties(board);
+
+	fpset_destroy(visited);
+	frames_destroy(&frames);
+	return len;
+}
+
+/**
+ * Measure the move generators throughput on the boards of a solution.
+ */
+void bench_movegen(Board *board) {
+	int i, samples_cnt;
+	unsigned long total;
+	double elapsed;
+	Move moves[MAXMOVES];
+	MultiMove multimoves[MAXMULTIMOVES];
+	Board *samples;
+	struct timespec start;
+
+	samples_cnt = bench_samples(board, &samples);
+	printf("Boards: %d\n", samples_cnt);
+
+	total = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCH_CALLS; i++)
+		total += gen_moves(&samples[i % samples_cnt], moves);
+	elapsed = bench_elapsed(&start);
+	printf("gen_moves: %d calls, %lu moves in %.3fs, %.0f moves/s\n",
+			BENCH_CALLS, total, elapsed, total / elapsed);
+
+	total = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCH_CALLS; i++)
+		total += gen_multimoves(&samples[i % samples_cnt], multimoves);
+	elapsed = bench_elapsed(&start);
+	printf("gen_multimoves: %d calls, %lu moves in %.3fs, %.0f moves/s\n",
+			BENCH_CALLS, total, elapsed, total / elapsed);
+
+	free(samples);
+}
+
+static uint64_t bench_mix(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static void* bench_claim(void *arg) {
+	uint64_t i;
+	unsigned long claimed;
+	Claimer *claimer = arg;
+
+	// Counted locally, the claimers of the threads share cache lines
+	for (claimed = 0, i = claimer->first; i < claimer->first + claimer->count; i++)
+		claimed += fpset_try_claim(claimer->set, bench_mix(i));
+	claimer->claimed = claimed;
+	return NULL;
+}
+
+/**
+ * Measure the shared fingerprint set throughput from 1 to max_threads
+ * threads claiming overlapping fingerprints.
+ */
+void bench_fpset(int max_threads) {
+	int threads, i, err;
+	unsigned long count, distinct, claimed;
+	double elapsed;
+	FpSet *set;
+	Claimer *claimers;
+	struct timespec start;
+
+	claimers = (Claimer*)malloc(max_threads * sizeof(Claimer));
+	assert(claimers != NULL);
+
+	for (threads = 1; threads <= max_threads; threads++) {
+		// Room for the distinct fingerprints below the maximum load
+		count = BENCH_CLAIMS / threads / 2 * 2;
+		distinct = (threads + 1) * count / 2;
+		fpset_new(&set, distinct / 3 * 4 + 16);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < threads; i++) {
+			claimers[i].set = set;
+			claimers[i].first = (uint64_t) i * count / 2;
+			claimers[i].count = count;
+			claimers[i].claimed = 0;
+			err = pthread_create(&claimers[i].thread, NULL, bench_claim, &claimers[i]);
+			assert(err == 0);
+		}
+		for (claimed = 0, i = 0; i < threads; i++) {
+			err = pthread_join(claimers[i].thread, NULL);
+			assert(err == 0);
+			claimed += claimers[i].claimed;
+		}
+		elapsed = bench_elapsed(&start);
+
+		assert(claimed == fpset_size(set));
+		assert(claimed == distinct);
+		printf("fpset_try_claim: %d threads, %lu claims, %lu new in %.3fs, %.0f claims/s\n",
+				threads, threads * count, claimed, elapsed, threads * count / elapsed);
+		fpset_destroy(set);
+	}
+
+	free(claimers);
+}
@@ -0,0 +1,9 @@
+#ifndef FREECELL_BENCH_H
+#define FREECELL_BENCH_H
+
+#include "board.h"
+
+void bench_movegen(Board *board);
+void bench_fpset(int max_threads);
+
+#endif
@@ -0,0 +1,103 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include "bnb.h"
+#include "board.h"
+#include "deadlock.h"
+#include "freecell.h"
+#include "heuristic.h"
+#include "stats.h"
+#include "strategy.h"
+#include "ttable.h"
+
+/**
+ * Determines whether the board must be expanded, it is not when it was
+ * already reached with fewer or as many moves. The best solution only
+ * gets shorter so that search was as deep as this one would be.
+ */
+static bool bnb_enter(TTable *table, uint64_t fingerprint, int g, int best) {
+	TEntry *entry;
+
+	entry = ttable_probe(table, fingerprint);
+	if (entry && entry->g <= g) return false;
+	ttable_store(table, fingerprint, g, MIN(best, UINT16_MAX));
+	return true;
+}
+
+/**
+ * Depth-first branch and bound, the search goes on once the game is won
+ * to find shorter solutions. The boards whose moves played plus the
+ * heuristic lower bound reach the best solution (or the target when
+ * there is none yet) are cut. The search stops once it is exhausted or
+ * after budget expanded boards (0 for no limit), the frames are then
+ * left with the best solution.
+ */
+bool bnb(Board *board, Frames *frames, int target, unsigned long budget) {
+	int best, i;
+	bool found;
+	Move m;
+	Goal *goal;
+	Frames solution;
+	TTable *table;
+
+	ttable_new(&table, TTABLE_DEFAULT_SIZE);
+	frames_init(&solution);
+	best = target ? target : INT_MAX;
+	found = false;
+
+	RECURSION:;
+	if (is_game_won(board)) {
+		if (frames->journal.len < best) {
+			best = frames->journal.len;
+			found = true;
+			frames_copy(&solution, frames);
+			printf("Solution in %d steps after %lu nodes.\n", best, stats.nodes);
+		}
+		goto BACKTRACK;
+	}
+
+	// Out of budget, go back on the initial board
+	if (budget && stats.visited >= budget) {
+		journal_undo(&frames->journal, board, 0);
+		frames->depth = 0;
+		goto BACKTRACK;
+	}
+
+	// Create a new node on top of the frames
+	goal = frames_push(frames);
+	stats.nodes++;
+	compute_properties(board);
+
+	if (frames->journal.len + heuristic(board) < best
+			&& !is_deadlocked(board)
+			&& bnb_enter(table, board->hash, frames->journal.len, best)) {
+		stats.visited++;
+		RECURSION_RETURN:;
+		if (strat_next(board, goal) != STRAT_NULL)
+			goto RECURSION;
+	}
+
+	assert(goal->start == frames->journal.len);
+	frames->depth--;
+
+	BACKTRACK:;
+	if (frames->depth) {
+		goal = &frames->goals[frames->depth - 1];
+		journal_undo(&frames->journal, board, goal->start);
+		compute_properties(board);
+		goto RECURSION_RETURN;
+	}
+
+	// Back on the initial board, play the best solution
+	if (found) {
+		frames_copy(frames, &solution);
+		for (i = 0; i < frames->journal.len; i++) {
+			m = frames->journal.moves[i];
+			move(board, (Card*) board + MOVE_FROM(m), (Card*) board + MOVE_TO(m));
+		}
+	}
+
+	frames_destroy(&solution);
+	ttable_destroy(table);
+	return found;
+}
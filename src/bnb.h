@@ -0,0 +1,10 @@
+#ifndef FREECELL_BNB_H
+#define FREECELL_BNB_H
+
+#include <stdbool.h>
+#include "board.h"
+#include "freecell.h"
+
+bool bnb(Board *board, Frames *frames, int target, unsigned long budget);
+
+#endif
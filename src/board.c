@@ -1,9 +1,27 @@
 #include <assert.h>
 #include <fcntl.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "board.h"
+#include "stats.h"
+
+/* Random keys for each card on each "slot". In the cascades, the slot
+ * is the card it is stacked on (or the nullcard at the top of the
+ * column) instead of the column and row, all the freecells share a same
+ * slot and so does the foundation. The key of the board is thus the
+ * same whatever the order of the cascades and of the freecells. */
+#define SLOT_FREECELL 53
+#define SLOT_FOUNDATION 54
+static uint64_t zobrist[53][55];
+
+// Card properties, bit Y of card_builds[X] is set when X can be stacked
+// on Y in a cascade
+uint8_t card_rank[53];
+uint8_t card_suit[53];
+uint64_t card_builds[53];
 
 int count_freecell(Board *board) {
 	int freecell_cnt, col;
@@ -29,37 +47,25 @@ int count_empty_column(Board *board) {
 
 
 /**
- * Determines whether we can move the ``fromcard`` on the ``tocard`` given
- * where (`f` freecell, `h` foundation, `c` columns) the ``tocard`` is.
+ * Determines whether we can move the ``fromcard`` on the ``tocard`` in
+ * a cascade (the ``tocard`` being the nullcard on empty cascades).
  */
-bool is_move_valid(Card fromcard, Card tocard, char destination) {
-	if (is_nullcard(fromcard))
-		return false;
+bool can_build(Card fromcard, Card tocard) {
+	return card_builds[fromcard] >> tocard & 1;
+}
 
-	switch (destination) {
-		case 'f':  // freecell
-			return tocard.rank == 0;
-		case 'h':  // foundation
-			return (fromcard.color == tocard.color
-				&& fromcard.suit == tocard.suit
-				&& fromcard.rank == tocard.rank + 1
-			);
-		case 'c':  // column
-			return (is_nullcard(tocard) || (
-					fromcard.color != tocard.color
-					&& fromcard.rank == tocard.rank - 1
-				)
-			);
-		default:
-			assert(false);
-	}
+/**
+ * Determines whether we can move the card to its foundation.
+ */
+bool can_home(Board *board, Card card) {
+	return card_rank[card] == board->fdlen[card_suit[card]];
 }
 
 /**
  * Determines whether the specified card is nullcard.
  */
 bool is_nullcard(Card card) {
-	return card.rank == nullcard.rank;
+	return card == NULLCARD;
 }
 
 /**
@@ -88,16 +94,6 @@ bool is_game_won(Board *board) {
 	);
 }
 
-/**
- * Determines if two card are equals
- */
-bool are_card_equal(Card c1, Card c2) {
-	if (c1.rank != c2.rank) return false;
-	if (c1.suit != c2.suit) return false;
-	if (c1.color != c2.color) return false;
-	return true;
-}
-
 /**
  * Get the lowest card of the specified column.
  */
@@ -112,87 +108,192 @@ Card* highest_sorted_card(Board *board, int col) {
 	return &(board->cascade[col][board->cslen[col] - board->sortdepth[col]]);
 }
 
+/**
+ * Get where a card is on the board.
+ */
+Card* locate_card(Board *board, Card searched_card) {
+	return (Card*) board + board->location[searched_card];
+}
+
 /**
  * Searches for a precise card in the cascades
  */
 CardPosPair search_card(Board *board, Card searched_card) {
-	int col, row;
 	Card *card;
 	CardPosPair cpp;
 
 	memset(&cpp, 0, sizeof(CardPosPair));
 
-	for (col = 0; col < 4; col++) {
-		if (!are_card_equal(board->freecell[col], searched_card)) continue;
-		cpp.col = col;
-		cpp.row = MAXCSLEN;
+	card = locate_card(board, searched_card);
+	if (card >= (Card*) board->cascade) {
+		cpp.col = (card - (Card*) board->cascade) / MAXCSLEN;
+		cpp.row = (card - (Card*) board->cascade) % MAXCSLEN;
 		return cpp;
 	}
-
-	for (col = 0; col < 8; col++) {
-		for (row = 1, card = bottom_card(board, col); !is_nullcard(*card); row++, card--) {
-			if (!are_card_equal(searched_card, *card)) continue;
-			cpp.col = col;
-			cpp.row = board->cslen[col] - row;
-			return cpp;
-		}
-	}
-	assert(false);
+	assert(card < (Card*) board->foundation);
+	cpp.col = card - board->freecell;
+	cpp.row = MAXCSLEN;
+	return cpp;
 }
 
 /**
- * Compute how many cards are sorted (by the solitaire rule) from the
- * bottom of each column.
+ * Recompute the various board properties of the columns changed since
+ * the last call.
  */
-void compute_sortdepth(Board *board) {
+void compute_properties(Board *board) {
 	int col;
+
 	for (col = 0; col < 8; col++) {
+		if (!(board->dirty & (1 << col))) {
+			stats.columns_saved++;
+			continue;
+		}
 		compute_sortdepth_col(board, col);
+		compute_buildfactor_col(board, col);
+		compute_buried_col(board, col);
+		stats.columns++;
 	}
+	board->dirty = 0;
 }
 
+/**
+ * Compute how many cards are sorted (by the solitaire rule) from the
+ * bottom of the column.
+ */
 void compute_sortdepth_col(Board *board, int col) {
 	int depth;
 	Card *card;
 
 	card = bottom_card(board, col);
 	depth = !is_nullcard(*card);
-	while(!is_nullcard(*(card - 1)) && is_move_valid(*card, *(card - 1), 'c')) {
+	while(!is_nullcard(*(card - 1)) && can_build(*card, *(card - 1))) {
 		depth++;
 		card--;
 	}
 	board->sortdepth[col] = depth;
+	if (is_fully_sorted(board, col)) board->unsorted &= ~(1 << col);
+	else board->unsorted |= 1 << col;
 }
 
 /**
- * Compute the "build factor" of each column, the "build factor" indicates
+ * Compute the "build factor" of the column, the "build factor" indicates
  * how appropriate it is to add cards on the column. It is better (higher
  * bf value) to build on fully sorted columns, it is then better to not
  * build on columns where a lot of low value cards are blocked.
  */
-void compute_buildfactor(Board *board) {
-	int col;
+void compute_buildfactor_col(Board *board, int col) {
 	Card *highcard, *card;
 
-	for (col = 0; col < 8; col++) {
-		if (is_empty(board, col)) {
-			board->buildfactor[col] = 0;
-		} else if (is_fully_sorted(board, col)) {
-			board->buildfactor[col] = board->cascade[col][1].rank * MAXCSLEN + board->cslen[col];
-		} else {
-			board->buildfactor[col] = -board->cslen[col];
-			highcard = highest_sorted_card(board, col);
-			for (card = highcard; !is_nullcard(*card); card--) {
-				if (card->rank < highcard->rank) {
-					board->buildfactor[col] -= (highcard->rank - card->rank);
-				} else {
-					highcard = card;
-				}
+	if (is_empty(board, col)) {
+		board->buildfactor[col] = 0;
+	} else if (is_fully_sorted(board, col)) {
+		board->buildfactor[col] = RANK(board->cascade[col][1]) * MAXCSLEN + board->cslen[col];
+	} else {
+		board->buildfactor[col] = -board->cslen[col];
+		highcard = highest_sorted_card(board, col);
+		for (card = highcard; !is_nullcard(*card); card--) {
+			if (RANK(*card) < RANK(*highcard)) {
+				board->buildfactor[col] -= (RANK(*highcard) - RANK(*card));
+			} else {
+				highcard = card;
 			}
 		}
 	}
 }
 
+/**
+ * Count the cards stacked on a lower card of their suit, they must be
+ * moved away before going to the foundation.
+ */
+void compute_buried_col(Board *board, int col) {
+	int row;
+	Card card;
+	uint8_t low[4] = {KING + 1, KING + 1, KING + 1, KING + 1};
+
+	board->buried[col] = 0;
+	for (row = 1; row < board->cslen[col]; row++) {
+		card = board->cascade[col][row];
+		if (RANK(card) > low[SUIT(card)]) board->buried[col]++;
+		else low[SUIT(card)] = RANK(card);
+	}
+}
+
+/**
+ * Get the Zobrist slot of a card on the board.
+ */
+static int zobrist_slot(Board *board, Card *card) {
+	if (card >= (Card*) board->cascade)
+		return *(card - 1);
+	if (card >= (Card*) board->foundation)
+		return SLOT_FOUNDATION;
+	return SLOT_FREECELL;
+}
+
+/**
+ * Compute the Zobrist key of the board from scratch, it is then kept up
+ * to date by move().
+ */
+void compute_hash(Board *board) {
+	Card *card;
+
+	board->hash = 0;
+	for (card = (Card*) board; card < (Card*) board->cascade + 8 * MAXCSLEN; card++) {
+		if (is_nullcard(*card)) continue;
+		board->hash ^= zobrist[*card][zobrist_slot(board, card)];
+	}
+}
+
+/**
+ * Compute the location of every card from scratch, it is then kept up
+ * to date by move().
+ */
+void compute_location(Board *board) {
+	Card *card;
+
+	for (card = (Card*) board; card < (Card*) board->cascade + 8 * MAXCSLEN; card++) {
+		if (is_nullcard(*card)) continue;
+		board->location[*card] = card - (Card*) board;
+	}
+}
+
+/**
+ * Fill the Zobrist table using splitmix64, the seed is fixed so
+ * the keys are the same on every run.
+ */
+static void zobrist_init(void) {
+	int card, slot;
+	uint64_t state, z;
+
+	state = 0;
+	for (card = 0; card < 53; card++) {
+		for (slot = 0; slot < 55; slot++) {
+			z = (state += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			zobrist[card][slot] = z ^ (z >> 31);
+		}
+	}
+}
+
+/**
+ * Fill the card properties tables.
+ */
+static void cards_init(void) {
+	Card card, other;
+
+	for (card = 1; card <= 52; card++) {
+		card_rank[card] = (card - 1) % 13 + 1;
+		card_suit[card] = (card - 1) / 13;
+	}
+	for (card = 1; card <= 52; card++) {
+		card_builds[card] = 1;  // on the nullcard of an empty cascade
+		for (other = 1; other <= 52; other++) {
+			if (COLOR(card) != COLOR(other) && RANK(card) + 1 == RANK(other))
+				card_builds[card] |= (uint64_t) 1 << other;
+		}
+	}
+}
+
 /**
  * Shuffle a deck of card.
  */
@@ -213,24 +314,18 @@ void shuffle(Card *deck, int len) {
  */
 void board_init(Board *board) {
 	int col;
-	Card newcard;
-
-	nullcard.rank = 0;
-	nullcard.suit = 0;
-	nullcard.color = 0;
-	nullcard._padding = 0;
 
+	cards_init();
+	zobrist_init();
 	memset(board, 0, sizeof(Board));
+	board->dirty = 0xFF;
 
 	for (col = 0; col < 8; col++) {
-		board->cascade[col][0] = nullcard;
+		board->cascade[col][0] = NULLCARD;
 		board->cslen[col] = 1;
 	}
 	for (col = 0; col < 4; col++) {
-		newcard.color = col / 2;
-		newcard.suit = col % 2;
-		newcard.rank = 0;
-		board->foundation[col][0] = newcard;
+		board->foundation[col][0] = NULLCARD;
 		board->fdlen[col] = 1;
 	}
 }
@@ -240,21 +335,11 @@ void board_init(Board *board) {
  */
 void board_deal(Board *board) {
 	int row, col;
-	int symbol, color, value;
-	Card newcard;
 	Card deck[52];
 
 	// Create a deck of card
-	for (color = 0; color < 2; color++) {
-		for (symbol = 0; symbol < 2; symbol++) {
-			for (value = 1; value < 14; value++) {
-				newcard.color = color;
-				newcard.suit = symbol;
-				newcard.rank = value;
-				newcard._padding = 0;
-				deck[(color * 2 + symbol) * 13 + value - 1] = newcard;
-			}
-		}
+	for (col = 0; col < 52; col++) {
+		deck[col] = col + 1;
 	}
 	shuffle(deck, 52);
 
@@ -273,30 +358,31 @@ void board_deal(Board *board) {
 	}
 	for (row = 8; row < MAXCSLEN; row++) {
 		for (col = 0; col < 8; col++) {
-			board->cascade[col][row] = nullcard;
+			board->cascade[col][row] = NULLCARD;
 		}
 	}
+	compute_hash(board);
+	compute_location(board);
 }
 
 /**
  * Load a board from an ascii text file.
  */
 void board_load(Board *board, const char *pathname) {
-	int fd, row, col;
+	int fd, row, col, rank, suit;
 	char line[32];
 	int depth[8] = {1, 1, 1, 1, 1, 1, 1, 1};
 	Card newcard;
 
 	fd = open(pathname, O_RDONLY);
 	assert(fd > 2);
-	newcard._padding = 0;
 	for (row = 1; row < MAXCSLEN; row++) {
 		if (!read(fd, line, 32)) break;
 		for (col = 0; col < 8; col++) {
 			switch (line[col * 4 + 1]) {
-				case ' ': newcard.rank = nullcard.rank; break;
-				case '1': newcard.rank = 1; break;
-				case 'A':
+				case ' ': rank = 0; break;
+				case '1':
+				case 'A': rank = 1; break;
 				case '2':
 				case '3':
 				case '4':
@@ -304,21 +390,22 @@ void board_load(Board *board, const char *pathname) {
 				case '6':
 				case '7':
 				case '8':
-				case '9': newcard.rank = line[col * 4 + 1] - '0'; break;
-				case '0': newcard.rank = 10; break;
-				case 'J': newcard.rank = 11; break;
-				case 'Q': newcard.rank = 12; break;
-				case 'K': newcard.rank = 13; break;
+				case '9': rank = line[col * 4 + 1] - '0'; break;
+				case '0': rank = 10; break;
+				case 'J': rank = 11; break;
+				case 'Q': rank = 12; break;
+				case 'K': rank = 13; break;
 				default: assert(0);
 			}
 			switch (line[col * 4 + 2]) {
-				case ' ': newcard.color = nullcard.color; newcard.suit = nullcard.suit; break;
-				case 'S': newcard.color = 0; newcard.suit = 0; break;
-				case 'C': newcard.color = 0; newcard.suit = 1; break;
-				case 'H': newcard.color = 1; newcard.suit = 0; break;
-				case 'D': newcard.color = 1; newcard.suit = 1; break;
+				case ' ': suit = 0; break;
+				case 'S': suit = 0; break;
+				case 'C': suit = 1; break;
+				case 'H': suit = 2; break;
+				case 'D': suit = 3; break;
 				default: assert(0);
 			}
+			newcard = rank ? CARD(suit, rank) : NULLCARD;
 			if (!is_nullcard(newcard)) {
 				assert(depth[col] == row);
 				depth[col]++;
@@ -330,24 +417,60 @@ void board_load(Board *board, const char *pathname) {
 	for (col = 0; col < 8; col++) {
 		board->cslen[col] = depth[col];
 	}
+	compute_hash(board);
+	compute_location(board);
+}
+
+/**
+ * Save the board in 52 bytes, the slot of every card.
+ */
+void board_pack(Board *board, uint8_t *packed) {
+	memcpy(packed, board->location + 1, 52);
+}
+
+/**
+ * Restore a board saved by board_pack.
+ */
+void board_unpack(Board *board, const uint8_t *packed) {
+	int col;
+	Card card, *slot;
+
+	memset(board, 0, offsetof(Board, hash));
+	for (col = 0; col < 8; col++) board->cslen[col] = 1;
+	for (col = 0; col < 4; col++) board->fdlen[col] = 1;
+
+	for (card = 1; card <= 52; card++) {
+		slot = (Card*) board + packed[card - 1];
+		*slot = card;
+		if (slot >= (Card*) board->cascade) {
+			col = (slot - (Card*) board->cascade) / MAXCSLEN;
+			board->cslen[col] = MAX(board->cslen[col], (slot - board->cascade[col]) + 1);
+		} else if (slot >= (Card*) board->foundation) {
+			board->fdlen[SUIT(card)] = MAX(board->fdlen[SUIT(card)], RANK(card) + 1);
+		}
+	}
+
+	memcpy(board->location + 1, packed, 52);
+	compute_hash(board);
+	board->dirty = 0xFF;
 }
 
 void setcardstr(Card card, char *cardstr) {
 	cardstr[0] = ' ';
-	if (card.rank == 0) {
+	if (is_nullcard(card)) {
 		cardstr[1] = cardstr[2] = ' ';
 		return;
 	}
 
-	switch (card.rank) {
+	switch (RANK(card)) {
 		case 10: cardstr[0] = '1'; cardstr[1] = '0'; break;
 		case 11: cardstr[1] = 'J'; break;
 		case 12: cardstr[1] = 'Q'; break;
 		case 13: cardstr[1] = 'K'; break;
-		default: cardstr[1] = '0' + (char) card.rank;
+		default: cardstr[1] = '0' + (char) RANK(card);
 	}
 
-	switch (card.color * 2 + card.suit) {
+	switch (SUIT(card)) {
 		case 0: cardstr[2] = 'S'; break;
 		case 1: cardstr[2] = 'C'; break;
 		case 2: cardstr[2] = 'H'; break;
@@ -413,6 +536,7 @@ void move(Board *board, Card *card1, Card *card2) {
 	// Update depth of column and of foundation
 	if (card1 >= (Card*) board->cascade) {
 		board->cslen[(card1 - (Card*) board->cascade) / MAXCSLEN]--;
+		board->dirty |= 1 << ((card1 - (Card*) board->cascade) / MAXCSLEN);
 	} else if (card1 >= (Card*) board->foundation) {
 		board->fdlen[(card1 - (Card*) board->foundation) / MAXFDLEN]--;
 	} else {
@@ -420,14 +544,68 @@ void move(Board *board, Card *card1, Card *card2) {
 
 	if (card2 >= (Card*) board->cascade) {
 		board->cslen[(card2 - (Card*) board->cascade) / MAXCSLEN]++;
+		board->dirty |= 1 << ((card2 - (Card*) board->cascade) / MAXCSLEN);
 	} else if (card2 >= (Card*) board->foundation) {
 		board->fdlen[(card2 - (Card*) board->foundation) / MAXFDLEN]++;
 	} else {
 	}
 
 	// Move the card
+	board->hash ^= zobrist[*card1][zobrist_slot(board, card1)];
+	board->hash ^= zobrist[*card1][zobrist_slot(board, card2)];
+	board->location[*card1] = card2 - (Card*) board;
 	*card2 = *card1;
-	*card1 = nullcard;
+	*card1 = NULLCARD;
+}
+
+void journal_init(Journal *journal) {
+	journal->moves = NULL;
+	journal->len = 0;
+	journal->capacity = 0;
+}
+
+void journal_destroy(Journal *journal) {
+	free(journal->moves);
+	journal_init(journal);
+}
+
+/**
+ * Replace the moves of dst by the ones of src, the moves are not played.
+ */
+void journal_copy(Journal *dst, Journal *src) {
+	dst->len = src->len;
+	if (src->len == 0) return;  // src->moves may still be NULL
+	if (dst->capacity < src->len) {
+		dst->capacity = src->len;
+		dst->moves = (Move*)realloc(dst->moves, dst->capacity * sizeof(Move));
+		assert(dst->moves != NULL);
+	}
+	memcpy(dst->moves, src->moves, src->len * sizeof(Move));
+}
+
+/**
+ * Move a card and record the move in the journal.
+ */
+void journal_move(Journal *journal, Board *board, Card *fromcard, Card *tocard) {
+	if (journal->len == journal->capacity) {
+		journal->capacity = journal->capacity ? journal->capacity * 2 : 1024;
+		journal->moves = (Move*)realloc(journal->moves, journal->capacity * sizeof(Move));
+		assert(journal->moves != NULL);
+	}
+	journal->moves[journal->len++] = MOVE(fromcard - (Card*) board, tocard - (Card*) board);
+	move(board, fromcard, tocard);
+}
+
+/**
+ * Undo the most recent moves until the journal is back to len moves.
+ */
+void journal_undo(Journal *journal, Board *board, int len) {
+	Move m;
+
+	while (journal->len > len) {
+		m = journal->moves[--journal->len];
+		move(board, (Card*) board + MOVE_TO(m), (Card*) board + MOVE_FROM(m));
+	}
 }
 
 void humanmove(Board *board, int fromcol, int tocol) {
@@ -437,7 +615,7 @@ void humanmove(Board *board, int fromcol, int tocol) {
 	if (fromcol >= 10) fromcard = &(board->freecell[fromcol - 10]);
 	else fromcard = bottom_card(board, fromcol - 1);
 
-	suit = fromcard->color * 2 + fromcard->suit;
+	suit = SUIT(*fromcard);
 	if (tocol == 0) tocard = &(board->foundation[suit][board->fdlen[suit]]);
 	else if (tocol >= 10) tocard = &(board->freecell[tocol-10]);
 	else tocard = bottom_card(board, tocol - 1) + 1;
@@ -452,17 +630,171 @@ int supermove_depth(Board *board, int fromcol, int tocol) {
 	highcard = highest_sorted_card(board, fromcol);
 	tocard = bottom_card(board, tocol);
 
-	if (highcard->rank < tocard->rank - 1) return 0;
-	if (fromcard->rank > tocard->rank - 1) return 0;
-	if (tocard->color == highcard->color) {
-		   if ((tocard->rank & 1) != (highcard->rank & 1)) return 0;
-	} else if ((tocard->rank & 1) == (highcard->rank & 1)) return 0;
+	if (RANK(*highcard) < RANK(*tocard) - 1) return 0;
+	if (RANK(*fromcard) > RANK(*tocard) - 1) return 0;
+	if (COLOR(*tocard) == COLOR(*highcard)) {
+		   if ((RANK(*tocard) & 1) != (RANK(*highcard) & 1)) return 0;
+	} else if ((RANK(*tocard) & 1) == (RANK(*highcard) & 1)) return 0;
+
+	return RANK(*tocard) - RANK(*fromcard);
+}
+
+
+/**
+ * Scratch state of the supermove planner. The cards are never touched,
+ * only the columns length and the freecells occupancy are tracked to
+ * compute the slots of the planned moves.
+ */
+typedef struct plan {
+	Board *board;
+	uint8_t cslen[8];
+	uint8_t freecells;  // bitmask of the free freecells
+	uint8_t empty;      // bitmask of the empty columns, tocol excluded
+	uint8_t busy;       // bitmask of the columns already used by a via
+	int freecell_cnt;
+	int empty_cnt;
+	int capacity;       // (freecell_cnt + 1) * 2^empty_cnt
+	int via_cnt;
+	int8_t via[8];      // non-empty columns temporary holding the run
+	int8_t via_depth[8];
+	Move *moves;
+	int len;
+} Plan;
+
+/**
+ * Plan a single card move, columns are 0-7 and freecells are 8-11.
+ */
+static void plan_step(Plan *plan, int from, int to) {
+	Card *fromcard, *tocard;
+
+	if (from < 8) fromcard = &(plan->board->cascade[from][--plan->cslen[from]]);
+	else {
+		fromcard = &(plan->board->freecell[from - 8]);
+		plan->freecells |= 1 << (from - 8);
+	}
+
+	if (to < 8) tocard = &(plan->board->cascade[to][plan->cslen[to]++]);
+	else {
+		tocard = &(plan->board->freecell[to - 8]);
+		plan->freecells &= ~(1 << (to - 8));
+	}
+
+	assert(plan->len < MAXSUPERMOVE);
+	plan->moves[plan->len++] = MOVE(fromcard - (Card*) plan->board, tocard - (Card*) plan->board);
+}
+
+/**
+ * Plan the standard supermove of card_cnt cards using the freecells and
+ * the empty columns of the mask, card_cnt must fit in the capacity.
+ */
+static void plan_supermove(Plan *plan, int fromcol, int tocol, int card_cnt, uint8_t empty, int empty_cnt) {
+	int col, cnt, freecell_cnt;
+	int8_t freecells[4];
+
+	if (card_cnt > plan->freecell_cnt + 1) {
+		// Move the top of the run on an empty column, the rest on
+		// tocol and the top back on it, each using one less column
+		assert(empty_cnt);
+		for (col = 0; !(empty >> col & 1); col++);
+		empty &= ~(1 << col);
+		cnt = card_cnt - MIN(card_cnt - 1, (plan->freecell_cnt + 1) << (empty_cnt - 1));
+		plan_supermove(plan, fromcol, col, cnt, empty, empty_cnt - 1);
+		plan_supermove(plan, fromcol, tocol, card_cnt - cnt, empty, empty_cnt - 1);
+		plan_supermove(plan, col, tocol, cnt, empty, empty_cnt - 1);
+		return;
+	}
 
-	return tocard->rank - fromcard->rank;
+	// Stack as many card in the freecells as needed, move the card and
+	// unstack the freecells
+	freecell_cnt = 0;
+	for (col = 0; col < 4 && freecell_cnt < card_cnt - 1; col++) {
+		if (!(plan->freecells >> col & 1)) continue;
+		plan_step(plan, fromcol, 8 + col);
+		freecells[freecell_cnt++] = col;
+	}
+	plan_step(plan, fromcol, tocol);
+	while (freecell_cnt)
+		plan_step(plan, 8 + freecells[--freecell_cnt], tocol);
 }
 
+/**
+ * Determines whether the card_cnt cards whose lowest is bottom can reach
+ * tocol, first using the freecells and empty columns then stacking the
+ * lowest cards of the run on other columns. The columns used that way
+ * are saved in the plan.
+ */
+static bool plan_fits(Plan *plan, int fromcol, int tocol, Card *bottom, int card_cnt) {
+	int col, depth;
+	Card *tocard;
+
+	if (card_cnt <= plan->capacity) return true;
+
+	for (col = 0; col < 8; col++) {
+		if (col == fromcol || col == tocol || plan->busy >> col & 1) continue;
+		if (is_empty(plan->board, col)) continue;
+		tocard = bottom_card(plan->board, col);
+		depth = RANK(*tocard) - RANK(*bottom);
+		if (depth < 1 || depth >= card_cnt || depth > plan->capacity) continue;
+		if (!can_build(*(bottom + 1 - depth), *tocard)) continue;
+
+		plan->busy |= 1 << col;
+		plan->via[plan->via_cnt] = col;
+		plan->via_depth[plan->via_cnt++] = depth;
+		if (plan_fits(plan, fromcol, tocol, bottom - depth, card_cnt - depth)) return true;
+		plan->busy &= ~(1 << col);
+		plan->via_cnt--;
+	}
+
+	return false;
+}
+
+/**
+ * Gather the freecells and empty columns then check the supermove fits.
+ */
+static bool plan_init(Plan *plan, Board *board, int fromcol, int tocol, int card_cnt) {
+	int col;
+	Card *bottom;
+
+	bottom = bottom_card(board, fromcol);
+	if (card_cnt < 1 || card_cnt >= board->cslen[fromcol]) return false;
+	if (!can_build(*(bottom + 1 - card_cnt), *bottom_card(board, tocol))) return false;
 
-bool supermove(Board *board, int fromcol, int tocol, int card_cnt, Stack * nextmoves) {
+	plan->board = board;
+	memcpy(plan->cslen, board->cslen, sizeof(plan->cslen));
+	plan->freecells = plan->empty = plan->busy = 0;
+	plan->freecell_cnt = plan->empty_cnt = 0;
+	for (col = 0; col < 4; col++) {
+		if (!is_nullcard(board->freecell[col])) continue;
+		plan->freecells |= 1 << col;
+		plan->freecell_cnt++;
+	}
+	for (col = 0; col < 8; col++) {
+		if (!is_empty(board, col) || col == tocol) continue;
+		plan->empty |= 1 << col;
+		plan->empty_cnt++;
+	}
+	plan->capacity = (plan->freecell_cnt + 1) << plan->empty_cnt;
+	plan->via_cnt = 0;
+	return plan_fits(plan, fromcol, tocol, bottom, card_cnt);
+}
+
+/**
+ * Determines whether the card_cnt sorted cards at the bottom of fromcol
+ * can be moved on tocol.
+ */
+bool can_supermove(Board *board, int fromcol, int tocol, int card_cnt) {
+	Plan plan;
+
+	return plan_init(&plan, board, fromcol, tocol, card_cnt);
+}
+
+/**
+ * Plan the moves of the card_cnt sorted cards at the bottom of fromcol
+ * on tocol. The board is left untouched, the moves are saved in the
+ * buffer (of MAXSUPERMOVE moves) and their count is returned, 0 when
+ * the supermove is impossible.
+ */
+int supermove_plan(Board *board, int fromcol, int tocol, int card_cnt, Move *moves) {
 	/* The bellow example showcases the supermove algorithm using a game
 	 * with a total of 2 freecells and 4 columns whose 1 is empty. We want
 	 * to move the second (C2) column on the first (C1) column.
@@ -492,119 +824,50 @@ bool supermove(Board *board, int fromcol, int tocol, int card_cnt, Stack * nextm
 	 * Move C3 {5, 4, 3, 2} -> C1 | 3 freecells | 3a 3b 34 31 41 b1 a1
 	 */
 
-	int freecell, col, row, depth;
-	Card *fromcard, *tocard;
-	Stack *tempmoves;
+	int via;
+	Plan plan;
 
-	tocard = bottom_card(board, tocol);
-	fromcard = bottom_card(board, fromcol);
-	freecell = count_freecell(board) + count_empty_column(board);
-	if (is_empty(board, tocol)) freecell--;
-
-	// Enough freecells to move the cards right away
-	if (card_cnt <= freecell + 1) {
-		assert(stack_new(&tempmoves) == CC_OK);
-
-		// Stack as many card in the freecells as needed
-		for (col = 0; col < 4 && card_cnt - 1; col++) {
-			if (!is_nullcard(board->freecell[col])) continue;
-			move(board, fromcard, &(board->freecell[col]));
-			assert(stack_push(nextmoves, fromcard) == CC_OK);
-			assert(stack_push(nextmoves, &(board->freecell[col])) == CC_OK);
-			assert(stack_push(tempmoves, &(board->freecell[col])) == CC_OK);
-			fromcard--;
-			card_cnt--;
-		}
-
-		// Stack as many card in the empty columns as needed
-		for (col = 0; col < 8 && card_cnt - 1; col++) {
-			if (!is_empty(board, col) || col == tocol) continue;
-			move(board, fromcard, bottom_card(board, col) + 1);
-			assert(stack_push(nextmoves, fromcard) == CC_OK);
-			assert(stack_push(nextmoves, bottom_card(board, col)) == CC_OK);
-			assert(stack_push(tempmoves, bottom_card(board, col)) == CC_OK);
-			fromcard--;
-			card_cnt--;
-		}
-
-		// No freecell left, this card must move otherwise the move is impossible
-		if (!is_move_valid(*fromcard, *tocard, 'c')) {
-			// Move impossible, undo stacking
-			while (stack_size(tempmoves)) {
-				fromcard++;
-				assert(stack_pop(nextmoves, NULL) == CC_OK);
-				assert(stack_pop(nextmoves, NULL) == CC_OK);
-				assert(stack_pop(tempmoves, (void**)&tocard) == CC_OK);
-				move(board, tocard, fromcard);
-			}
-			return false;
-		}
+	if (!plan_init(&plan, board, fromcol, tocol, card_cnt)) return 0;
 
-		// Move the card
-		tocard++;
-		move(board, fromcard, tocard);
-		assert(stack_push(nextmoves, fromcard) == CC_OK);
-		assert(stack_push(nextmoves, tocard) == CC_OK);
-		fromcard--;
-
-		// Unstack the cards from the freecells to the dest column
-		while (stack_size(tempmoves)) {
-			tocard++;
-			assert(stack_pop(tempmoves, (void**)&fromcard) == CC_OK);
-			move(board, fromcard, tocard);
-			assert(stack_push(nextmoves, fromcard) == CC_OK);
-			assert(stack_push(nextmoves, tocard) == CC_OK);
-		}
-		stack_destroy(tempmoves);
-		return true;
-	}
-
-	// Deep supermove, temporary stack some cards on a non-empty column
-	compute_sortdepth_col(board, fromcol);
-	for (col = 0; col < 8; col++) {
-		if (is_empty(board, col) || col == fromcol || col == tocol) continue;
-		depth = supermove_depth(board, fromcol, col);
-		if (depth && depth <= freecell + 1)
-			return deepsupermove(board, fromcol, col, tocol, card_cnt, depth, nextmoves);
+	// Stack the lowest cards on the via columns, move the rest and
+	// unstack the via columns in reverse order
+	plan.moves = moves;
+	plan.len = 0;
+	for (via = 0; via < plan.via_cnt; via++) {
+		plan_supermove(&plan, fromcol, plan.via[via], plan.via_depth[via], plan.empty, plan.empty_cnt);
+		card_cnt -= plan.via_depth[via];
 	}
+	plan_supermove(&plan, fromcol, tocol, card_cnt, plan.empty, plan.empty_cnt);
+	while (via--)
+		plan_supermove(&plan, plan.via[via], tocol, plan.via_depth[via], plan.empty, plan.empty_cnt);
 
-	// Deep supermove, temporary stack some cards on an empty column
-	for (col = 0; col < 8; col++) {
-		if (!is_empty(board, col) || col == tocol) continue;
-		return deepsupermove(board, fromcol, col, tocol, card_cnt, freecell, nextmoves);
-	}
-
-	// Impossible to supermove
-	return false;
+	return plan.len;
 }
 
-
-bool deepsupermove(Board *board, int fromcol, int tempcol, int tocol, int total_card_cnt, int card_cnt, Stack *nextmoves) {
-	int i;
-	Card *fromcard, *tocard;
-
-	assert(supermove(board, fromcol, tempcol, card_cnt, nextmoves));
-	if (!supermove(board, fromcol, tocol, total_card_cnt - card_cnt, nextmoves)) {
-		// Undo the first supermove
-		for (i = 0; i < card_cnt * 2 - 1; i++) {
-			assert(stack_pop(nextmoves, (void**)&fromcard) == CC_OK);
-			assert(stack_pop(nextmoves, (void**)&tocard) == CC_OK);
-			move(board, fromcard, tocard);
-		}
-		return false;
-	}
-	assert(supermove(board, tempcol, tocol, card_cnt, nextmoves));
-	return true;
+/**
+ * Move the card_cnt sorted cards at the bottom of fromcol on tocol,
+ * nothing is played when the supermove is impossible.
+ */
+bool supermove(Board *board, int fromcol, int tocol, int card_cnt, Journal *journal) {
+	int len, i;
+	Move moves[MAXSUPERMOVE];
+
+	len = supermove_plan(board, fromcol, tocol, card_cnt, moves);
+	for (i = 0; i < len; i++)
+		journal_move(journal, board, (Card*) board + MOVE_FROM(moves[i]), (Card*) board + MOVE_TO(moves[i]));
+	return len > 0;
 }
 
-bool superaccess(Board *board, CardPosPair cpp, Stack * nextmoves, bool use_empty) {
+bool superaccess(Board *board, CardPosPair cpp, Journal *journal, bool use_empty) {
 	int row, tocol, size, depth, freecell_cnt, empty_cols_cnt;
 	Card *fromcard, *tocard;
 	Card *empty_cols[8];
 	Card *freecells[4];
 
-	size = stack_size(nextmoves);
+	size = journal->len;
+	row = board->cslen[cpp.col] - 1;
 
+	CONTINUE:;
 	empty_cols_cnt=0;
 	for (tocol = 0; tocol < 8; tocol++)
 		if (is_empty(board, tocol))
@@ -614,26 +877,25 @@ bool superaccess(Board *board, CardPosPair cpp, Stack * nextmoves, bool use_empt
 		if (is_nullcard(board->freecell[tocol]))
 			freecells[freecell_cnt++] = &board->freecell[tocol];
 
-	row = board->cslen[cpp.col] - 1;
-	CONTINUE:;
 	while (row > cpp.row) {
 		// Supermove to another column
 		for (tocol = 0; tocol < 8; tocol++) {
 			if (is_empty(board, tocol) || tocol == cpp.col) continue;
 			depth = supermove_depth(board, cpp.col, tocol);
 			if (0 < depth && depth < row - cpp.row) {
-				if (!supermove(board, cpp.col, tocol, depth, nextmoves)) continue;
-				compute_sortdepth_col(board, cpp.col);
+				if (!supermove(board, cpp.col, tocol, depth, journal)) continue;
+				compute_properties(board);
 				row -= depth;
 				goto CONTINUE;
 			}
 		}
 
 		// Supermove to an empty column
-		if (use_empty && board->sortdepth[cpp.col] > 1) {
-			for (depth = MIN(supermove_depth(board, cpp.col, tocol), row - cpp.row); depth > 1; depth--) {
-				if (!supermove(board, cpp.col, tocol, depth, nextmoves)) continue;
-				compute_sortdepth_col(board, cpp.col);
+		for (tocol = 0; tocol < 8 && !is_empty(board, tocol); tocol++);
+		if (use_empty && tocol < 8 && board->sortdepth[cpp.col] > 1) {
+			for (depth = MIN(board->sortdepth[cpp.col], row - cpp.row); depth > 1; depth--) {
+				if (!supermove(board, cpp.col, tocol, depth, journal)) continue;
+				compute_properties(board);
 				row -= depth;
 				goto CONTINUE;
 			}
@@ -643,10 +905,8 @@ bool superaccess(Board *board, CardPosPair cpp, Stack * nextmoves, bool use_empt
 		fromcard = &board->cascade[cpp.col][row];
 		if (freecell_cnt || (use_empty && empty_cols_cnt)) {
 			tocard = freecell_cnt ? freecells[--freecell_cnt] : empty_cols[--empty_cols_cnt];
-			assert(stack_push(nextmoves, fromcard) == CC_OK);
-			assert(stack_push(nextmoves, tocard) == CC_OK);
-			move(board, fromcard, tocard);
-			compute_sortdepth_col(board, cpp.col);
+			journal_move(journal, board, fromcard, tocard);
+			compute_properties(board);
 			row--;
 			continue;
 		}
@@ -660,10 +920,7 @@ bool superaccess(Board *board, CardPosPair cpp, Stack * nextmoves, bool use_empt
 		return true;
 
 	// Couldn't unstack enough card, restore initial state
-	while (size < stack_size(nextmoves)) {
-		assert(stack_pop(nextmoves, (void**)&fromcard) == CC_OK);
-		assert(stack_pop(nextmoves, (void**)&tocard) == CC_OK);
-		move(board, fromcard, tocard);
-	}
+	journal_undo(journal, board, size);
+	compute_properties(board);
 	return false;
 }
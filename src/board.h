@@ -3,7 +3,6 @@
 
 #include <stdbool.h>
 #include <stdint.h>
-#include "stack.h"
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -13,14 +12,21 @@
 #define MAXCSLEN 20
 
 /**
- * Immutable card, there are 52 + the nullcard
+ * Immutable card, there are 52 + the nullcard (0). The cards are indexed
+ * by suit (spade, club, heart, diamond) then by rank, the two black
+ * suits first.
  */
-typedef struct card {
-	uint8_t _padding:2;
-	uint8_t color:1;
-	uint8_t suit:1;
-	uint8_t rank:4;
-} Card;
+typedef uint8_t Card;
+
+#define NULLCARD 0
+#define CARD(suit, rank) ((Card) ((suit) * 13 + (rank)))
+#define RANK(card) (card_rank[card])
+#define SUIT(card) (card_suit[card])
+#define COLOR(card) (card_suit[card] >> 1)
+
+extern uint8_t card_rank[53];
+extern uint8_t card_suit[53];
+extern uint64_t card_builds[53];
 
 /**
  * Mutable board as we cannot afford to keep each board in memory
@@ -32,35 +38,72 @@ typedef struct board {
 	uint8_t fdlen[4];
 	uint8_t cslen[8];
 
-	// Properties, must be recalculated after each move
+	// Zobrist key of the position regardless of the cascades and
+	// freecells order, updated by each move
+	uint64_t hash;
+
+	// Slot (offset from the first freecell) of each card, updated by
+	// each move
+	uint8_t location[53];
+
+	// Properties, must be recalculated after each move, only the
+	// columns flagged in the dirty bitmask are
+	uint8_t dirty;
+	uint8_t unsorted;  // bitmask of the columns not fully sorted
 	uint8_t sortdepth[8];
 	int buildfactor[8];
+	uint8_t buried[8];
 } Board;
 
+/**
+ * A move packed on 16 bits, the source and destination slots (offset
+ * from the first freecell) on 8 bits each.
+ */
+typedef uint16_t Move;
+
+#define MOVE(from, to) ((Move) ((from) << 8 | (to)))
+#define MOVE_FROM(move) ((move) >> 8)
+#define MOVE_TO(move) ((move) & 0xFF)
+
+// Longest sequence of moves a single supermove can expand to
+#define MAXSUPERMOVE 256
+
+/**
+ * Growable stack of the moves played on a board, it is used to undo
+ * them.
+ */
+typedef struct journal {
+	Move *moves;
+	int len;
+	int capacity;
+} Journal;
+
 typedef struct cardpospair {
 	unsigned int col:3;
 	unsigned int row:5;
 } CardPosPair;
 
-static Card nullcard;
-
 int count_freecell(Board *board);
 int count_empty_column(Board *board);
 
-bool is_move_valid(Card fromcard, Card tocard, char destination);
+bool can_build(Card fromcard, Card tocard);
+bool can_home(Board *board, Card card);
 bool is_nullcard(Card card);
 bool is_empty(Board *board, int col);
 bool is_fully_sorted(Board *board, int col);
 bool is_game_won(Board *board);
-bool are_card_equal(Card c1, Card c2);
 
 Card* bottom_card(Board *board, int col);
 Card* highest_sorted_card(Board *board, int col);
+Card* locate_card(Board *board, Card searched_card);
 CardPosPair search_card(Board *board, Card searched_card);
 
-void compute_sortdepth(Board *board);
+void compute_properties(Board *board);
 void compute_sortdepth_col(Board *board, int col);
-void compute_buildfactor(Board *board);
+void compute_buildfactor_col(Board *board, int col);
+void compute_buried_col(Board *board, int col);
+void compute_hash(Board *board);
+void compute_location(Board *board);
 
 void shuffle(Card *deck, int len);
 void setcardstr(Card card, char *cardstr);
@@ -69,12 +112,21 @@ void board_init(Board *board);
 void board_deal(Board *board);
 void board_load(Board *board, const char *pathname);
 void board_show(Board *board);
+void board_pack(Board *board, uint8_t *packed);
+void board_unpack(Board *board, const uint8_t *packed);
+
+void journal_init(Journal *journal);
+void journal_destroy(Journal *journal);
+void journal_copy(Journal *dst, Journal *src);
+void journal_move(Journal *journal, Board *board, Card *fromcard, Card *tocard);
+void journal_undo(Journal *journal, Board *board, int len);
 
 void move(Board *board, Card *card1, Card *card2);
 void humanmove(Board *board, int fromcol, int tocol);
 int supermove_depth(Board *board, int fromcol, int tocol);
-bool supermove(Board *board, int fromcol, int tocol, int card_cnt, Stack * nextmoves);
-bool deepsupermove(Board *board, int fromcol, int tempcol, int tocol, int total_card_cnt, int card_cnt, Stack *nextmoves);
-bool superaccess(Board *board, CardPosPair cpp, Stack * nextmoves, bool use_empty);
+bool can_supermove(Board *board, int fromcol, int tocol, int card_cnt);
+int supermove_plan(Board *board, int fromcol, int tocol, int card_cnt, Move *moves);
+bool supermove(Board *board, int fromcol, int tocol, int card_cnt, Journal *journal);
+bool superaccess(Board *board, CardPosPair cpp, Journal *journal, bool use_empty);
 
 #endif
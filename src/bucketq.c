@@ -0,0 +1,67 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bucketq.h"
+
+void bucketq_new(BucketQ **queue) {
+	*queue = (BucketQ*)malloc(sizeof(BucketQ));
+	assert(*queue != NULL);
+	(*queue)->buckets = NULL;
+	(*queue)->capacity = 0;
+	(*queue)->low = 0;
+	(*queue)->size = 0;
+}
+
+void bucketq_destroy(BucketQ *queue) {
+	int i;
+
+	for (i = 0; i < queue->capacity; i++)
+		free(queue->buckets[i].items);
+	free(queue->buckets);
+	free(queue);
+}
+
+/**
+ * Add an item, the priority must be positive.
+ */
+void bucketq_push(BucketQ *queue, int priority, uint32_t item) {
+	int capacity;
+	Bucket *bucket;
+
+	assert(priority >= 0);
+	if (priority >= queue->capacity) {
+		for (capacity = queue->capacity ? queue->capacity : 64; capacity <= priority; capacity *= 2);
+		queue->buckets = (Bucket*)realloc(queue->buckets, capacity * sizeof(Bucket));
+		assert(queue->buckets != NULL);
+		memset(queue->buckets + queue->capacity, 0, (capacity - queue->capacity) * sizeof(Bucket));
+		queue->capacity = capacity;
+	}
+
+	bucket = &queue->buckets[priority];
+	if (bucket->len == bucket->capacity) {
+		bucket->capacity = bucket->capacity ? bucket->capacity * 2 : 256;
+		bucket->items = (uint32_t*)realloc(bucket->items, bucket->capacity * sizeof(uint32_t));
+		assert(bucket->items != NULL);
+	}
+	bucket->items[bucket->len++] = item;
+
+	if (!queue->size || priority < queue->low) queue->low = priority;
+	queue->size++;
+}
+
+/**
+ * Remove an item of the lowest priority. Returns false when the queue is
+ * empty.
+ */
+bool bucketq_pop(BucketQ *queue, uint32_t *item) {
+	if (!queue->size) return false;
+
+	while (!queue->buckets[queue->low].len) queue->low++;
+	*item = queue->buckets[queue->low].items[--queue->buckets[queue->low].len];
+	queue->size--;
+	return true;
+}
+
+size_t bucketq_size(BucketQ *queue) {
+	return queue->size;
+}
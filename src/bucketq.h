@@ -0,0 +1,36 @@
+#ifndef FREECELL_BUCKETQ_H
+#define FREECELL_BUCKETQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Growable stack of 32 bits items sharing a same priority.
+ */
+typedef struct bucket {
+	uint32_t *items;
+	size_t len;
+	size_t capacity;
+} Bucket;
+
+/**
+ * Priority queue for small integer priorities, one bucket per priority.
+ * The lowest priority is served first, the items sharing a priority are
+ * served last-in first-out.
+ */
+typedef struct bucketq {
+	Bucket *buckets;
+	int capacity;  // number of buckets
+	int low;  // no item has a lower priority
+	size_t size;
+} BucketQ;
+
+void bucketq_new(BucketQ **queue);
+void bucketq_destroy(BucketQ *queue);
+
+void bucketq_push(BucketQ *queue, int priority, uint32_t item);
+bool bucketq_pop(BucketQ *queue, uint32_t *item);
+size_t bucketq_size(BucketQ *queue);
+
+#endif
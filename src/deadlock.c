@@ -0,0 +1,80 @@
+#include <stdbool.h>
+#include <string.h>
+#include "board.h"
+#include "deadlock.h"
+
+/**
+ * Determines whether the game is lost because there is no free space
+ * left and none can be made.
+ *
+ * Without freecells nor empty columns, a card can only leave its place
+ * once every card stacked on it did, to go either to the foundation
+ * once the previous card of its suit did, or on a cascade card of the
+ * next rank and opposite color that got uncovered. Those conditions are
+ * propagated to a fixpoint starting with the cards on the foundation.
+ * It tells every card that could ever move (and more as where the cards
+ * go is ignored) as long as no space is made. When neither a freecell
+ * card nor a whole column can move, no space will ever be made and the
+ * cards left in the cascades never reach the foundation.
+ */
+bool is_deadlocked(Board *board) {
+	int col, row, suit;
+	bool changed, clear;
+	bool lift[53], home[53];
+	Card card, parent, *slot;
+	CardPosPair cpp;
+
+	if (count_freecell(board) || count_empty_column(board)) return false;
+	if (is_game_won(board)) return false;
+
+	memset(lift, 0, sizeof(lift));
+	memset(home, 0, sizeof(home));
+	for (suit = 0; suit < 4; suit++) {
+		for (row = 1; row < board->fdlen[suit]; row++)
+			lift[board->foundation[suit][row]] = home[board->foundation[suit][row]] = true;
+	}
+
+	do {
+		changed = false;
+		for (card = 1; card <= 52; card++) {
+			if (lift[card]) continue;
+
+			// Every card stacked on this one can move
+			slot = locate_card(board, card);
+			if (slot >= (Card*) board->cascade) {
+				cpp = search_card(board, card);
+				clear = cpp.row == board->cslen[cpp.col] - 1 || lift[*(slot + 1)];
+				if (!clear) continue;
+			}
+
+			// To the foundation
+			if (RANK(card) == 1 || home[card - 1]) {
+				lift[card] = home[card] = true;
+				changed = true;
+				continue;
+			}
+
+			// On one of the two cards of the next rank and opposite color
+			if (RANK(card) == KING) continue;
+			for (suit = (1 - COLOR(card)) * 2; suit < (1 - COLOR(card)) * 2 + 2; suit++) {
+				parent = CARD(suit, RANK(card) + 1);
+				slot = locate_card(board, parent);
+				if (slot < (Card*) board->cascade) continue;
+				cpp = search_card(board, parent);
+				if (cpp.row == board->cslen[cpp.col] - 1 || lift[*(slot + 1)]) {
+					lift[card] = true;
+					changed = true;
+					break;
+				}
+			}
+		}
+	} while (changed);
+
+	// Space can be made
+	for (col = 0; col < 4; col++)
+		if (lift[board->freecell[col]]) return false;
+	for (col = 0; col < 8; col++)
+		if (lift[board->cascade[col][1]]) return false;
+
+	return true;
+}
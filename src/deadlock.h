@@ -0,0 +1,9 @@
+#ifndef FREECELL_DEADLOCK_H
+#define FREECELL_DEADLOCK_H
+
+#include <stdbool.h>
+#include "board.h"
+
+bool is_deadlocked(Board *board);
+
+#endif
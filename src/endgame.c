@@ -0,0 +1,335 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "board.h"
+#include "endgame.h"
+#include "mapping.h"
+#include "movegen.h"
+
+/* Endgame table of the boards with few cards left in play. Any such
+ * board is enumerated: the cards left are the highest of each suit, any
+ * of them can be on a freecell or anywhere in a cascade. The table
+ * holds their Zobrist key, sorted, and the number of single card moves
+ * left to win. With at most 12 cards in play every board is solvable,
+ * the table is used to play the shortest way home.
+ *
+ * The distances are found backward: the won board is at distance 0 and
+ * each pass resolves the boards with a move to a board resolved by the
+ * previous pass. The passes split the foundations over the threads,
+ * the boards each thread resolves are only written once all of them
+ * are done so the table is read-only while they run. */
+
+#define ENDGAME_MAGIC "FCEGTB01"
+#define ENDGAME_UNKNOWN 0xFF
+
+typedef struct endgame_header {
+	char magic[8];
+	uint64_t count;
+	uint64_t cards;
+} EndgameHeader;
+
+/**
+ * Shared state of the generation.
+ */
+typedef struct retro {
+	uint64_t *hashes;
+	uint8_t *dists;
+	size_t count;
+	size_t capacity;
+	int depth;
+
+	// Foundation heights of each suit left to enumerate
+	uint8_t (*configs)[4];
+	int config_cnt;
+	int next;
+	pthread_mutex_t lock;
+} Retro;
+
+/**
+ * Boards resolved by a thread during the current pass.
+ */
+typedef struct worker {
+	Retro *retro;
+	uint32_t *found;
+	size_t len;
+	size_t capacity;
+	pthread_t thread;
+} Worker;
+
+static const EndgameHeader *table = NULL;
+
+static int comp_hash(const void *p1, const void *p2) {
+	uint64_t h1 = *(const uint64_t*) p1, h2 = *(const uint64_t*) p2;
+	return (h1 > h2) - (h1 < h2);
+}
+
+/**
+ * Index of the key in the sorted array, -1 when it is missing.
+ */
+static long endgame_find(const uint64_t *hashes, size_t count, uint64_t hash) {
+	size_t low, high, mid;
+
+	for (low = 0, high = count; low < high;) {
+		mid = low + (high - low) / 2;
+		if (hashes[mid] < hash) low = mid + 1;
+		else high = mid;
+	}
+	return low < count && hashes[low] == hash ? (long) low : -1;
+}
+
+/**
+ * Put the cards one by one on the first empty freecell, anywhere in a
+ * cascade or alone in the first empty cascade, so each board comes out
+ * once. Visit each board once all the cards are placed.
+ */
+static void endgame_place(Board *board, const Card *cards, int len, void (*visit)(Board *, void *), void *arg) {
+	int col, row, i;
+
+	if (!len) {
+		compute_location(board);
+		compute_hash(board);
+		board->dirty = 0xFF;
+		visit(board, arg);
+		return;
+	}
+
+	for (i = 0; i < 4 && !is_nullcard(board->freecell[i]); i++);
+	if (i < 4) {
+		board->freecell[i] = *cards;
+		endgame_place(board, cards + 1, len - 1, visit, arg);
+		board->freecell[i] = NULLCARD;
+	}
+
+	for (col = 0; col < 8; col++) {
+		for (row = 1; row <= board->cslen[col]; row++) {
+			memmove(&board->cascade[col][row + 1], &board->cascade[col][row], board->cslen[col] - row);
+			board->cascade[col][row] = *cards;
+			board->cslen[col]++;
+			endgame_place(board, cards + 1, len - 1, visit, arg);
+			board->cslen[col]--;
+			memmove(&board->cascade[col][row], &board->cascade[col][row + 1], board->cslen[col] - row);
+			board->cascade[col][board->cslen[col]] = NULLCARD;
+		}
+		if (is_empty(board, col)) break;
+	}
+}
+
+/**
+ * Visit every board of the given foundation heights.
+ */
+static void endgame_enumerate(const uint8_t *heights, void (*visit)(Board *, void *), void *arg) {
+	int suit, rank, len;
+	Board board;
+	Card cards[ENDGAME_MAXCARDS];
+
+	// Not board_init, the Zobrist keys are shared by the threads
+	memset(&board, 0, sizeof(Board));
+	for (len = 0; len < 8; len++) board.cslen[len] = 1;
+	for (len = 0, suit = 0; suit < 4; suit++) {
+		for (rank = 1; rank <= heights[suit]; rank++)
+			board.foundation[suit][rank] = CARD(suit, rank);
+		board.fdlen[suit] = heights[suit] + 1;
+		for (; rank <= KING; rank++) cards[len++] = CARD(suit, rank);
+	}
+	endgame_place(&board, cards, len, visit, arg);
+}
+
+static void endgame_collect(Board *board, void *arg) {
+	Retro *retro = arg;
+
+	if (retro->count == retro->capacity) {
+		retro->capacity *= 2;
+		retro->hashes = (uint64_t*)realloc(retro->hashes, retro->capacity * sizeof(uint64_t));
+		assert(retro->hashes != NULL);
+	}
+	retro->hashes[retro->count++] = board->hash;
+}
+
+/**
+ * Save the board when one of its moves leads to a board of the previous
+ * distance.
+ */
+static void endgame_resolve(Board *board, void *arg) {
+	int i, len;
+	long id, next;
+	bool found;
+	Worker *worker = arg;
+	Retro *retro = worker->retro;
+	Move moves[MAXMOVES];
+	Card *fromcard, *tocard;
+
+	id = endgame_find(retro->hashes, retro->count, board->hash);
+	assert(id >= 0);
+	if (retro->dists[id] != ENDGAME_UNKNOWN) return;
+
+	found = retro->depth == 0 && is_game_won(board);
+	len = retro->depth ? gen_moves(board, moves) : 0;
+	for (i = 0; i < len && !found; i++) {
+		fromcard = (Card*) board + MOVE_FROM(moves[i]);
+		tocard = (Card*) board + MOVE_TO(moves[i]);
+		move(board, fromcard, tocard);
+		next = endgame_find(retro->hashes, retro->count, board->hash);
+		move(board, tocard, fromcard);
+		assert(next >= 0);
+		found = retro->dists[next] == retro->depth - 1;
+	}
+	if (!found) return;
+
+	if (worker->len == worker->capacity) {
+		worker->capacity *= 2;
+		worker->found = (uint32_t*)realloc(worker->found, worker->capacity * sizeof(uint32_t));
+		assert(worker->found != NULL);
+	}
+	worker->found[worker->len++] = id;
+}
+
+static void* endgame_work(void *arg) {
+	int config, err;
+	Worker *worker = arg;
+	Retro *retro = worker->retro;
+
+	for (;;) {
+		err = pthread_mutex_lock(&retro->lock);
+		assert(err == 0);
+		config = retro->next++;
+		err = pthread_mutex_unlock(&retro->lock);
+		assert(err == 0);
+		if (config >= retro->config_cnt) return NULL;
+		endgame_enumerate(retro->configs[config], endgame_resolve, worker);
+	}
+}
+
+/**
+ * Compute the table of the boards with up to cards cards in play and
+ * save it in a file.
+ */
+void endgame_generate(const char *pathname, int cards) {
+	int i, h0, h1, h2, h3, thread_cnt, err;
+	size_t pass_cnt, total, written;
+	Retro retro;
+	Worker *workers;
+	EndgameHeader header;
+	FILE *file;
+
+	assert(cards >= 0 && cards <= ENDGAME_MAXCARDS);
+
+	// Every foundation heights leaving up to cards cards in play
+	retro.configs = (uint8_t (*)[4])malloc(14 * 14 * 14 * 14 * sizeof(*retro.configs));
+	assert(retro.configs != NULL);
+	retro.config_cnt = 0;
+	for (h0 = 0; h0 <= KING; h0++)
+	for (h1 = 0; h1 <= KING; h1++)
+	for (h2 = 0; h2 <= KING; h2++)
+	for (h3 = 0; h3 <= KING; h3++) {
+		if (4 * KING - h0 - h1 - h2 - h3 > cards) continue;
+		retro.configs[retro.config_cnt][0] = h0;
+		retro.configs[retro.config_cnt][1] = h1;
+		retro.configs[retro.config_cnt][2] = h2;
+		retro.configs[retro.config_cnt++][3] = h3;
+	}
+
+	retro.capacity = 1 << 16;
+	retro.count = 0;
+	retro.hashes = (uint64_t*)malloc(retro.capacity * sizeof(uint64_t));
+	assert(retro.hashes != NULL);
+	for (i = 0; i < retro.config_cnt; i++)
+		endgame_enumerate(retro.configs[i], endgame_collect, &retro);
+	qsort(retro.hashes, retro.count, sizeof(uint64_t), comp_hash);
+	for (i = 1; (size_t) i < retro.count; i++)
+		assert(retro.hashes[i - 1] != retro.hashes[i]);
+
+	retro.dists = (uint8_t*)malloc(retro.count);
+	assert(retro.dists != NULL);
+	memset(retro.dists, ENDGAME_UNKNOWN, retro.count);
+	err = pthread_mutex_init(&retro.lock, NULL);
+	assert(err == 0);
+
+	thread_cnt = MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+	workers = (Worker*)malloc(thread_cnt * sizeof(Worker));
+	assert(workers != NULL);
+	for (i = 0; i < thread_cnt; i++) {
+		workers[i].retro = &retro;
+		workers[i].capacity = 1 << 10;
+		workers[i].found = (uint32_t*)malloc(workers[i].capacity * sizeof(uint32_t));
+		assert(workers[i].found != NULL);
+	}
+
+	printf("Boards: %lu, threads: %d\n", (unsigned long) retro.count, thread_cnt);
+	for (total = 0, retro.depth = 0; total < retro.count; retro.depth++) {
+		assert(retro.depth < ENDGAME_UNKNOWN);
+		retro.next = 0;
+		for (i = 0; i < thread_cnt; i++) {
+			workers[i].len = 0;
+			err = pthread_create(&workers[i].thread, NULL, endgame_work, &workers[i]);
+			assert(err == 0);
+		}
+		for (pass_cnt = 0, i = 0; i < thread_cnt; i++) {
+			err = pthread_join(workers[i].thread, NULL);
+			assert(err == 0);
+			for (; workers[i].len; workers[i].len--, pass_cnt++)
+				retro.dists[workers[i].found[workers[i].len - 1]] = retro.depth;
+		}
+		assert(pass_cnt > 0);
+		total += pass_cnt;
+		printf("Distance %d: %lu boards\n", retro.depth, (unsigned long) pass_cnt);
+	}
+
+	memcpy(header.magic, ENDGAME_MAGIC, 8);
+	header.count = retro.count;
+	header.cards = cards;
+	file = fopen(pathname, "wb");
+	assert(file != NULL);
+	written = fwrite(&header, sizeof(header), 1, file);
+	assert(written == 1);
+	written = fwrite(retro.hashes, sizeof(uint64_t), retro.count, file);
+	assert(written == retro.count);
+	written = fwrite(retro.dists, 1, retro.count, file);
+	assert(written == retro.count);
+	err = fclose(file);
+	assert(err == 0);
+
+	for (i = 0; i < thread_cnt; i++) free(workers[i].found);
+	free(workers);
+	pthread_mutex_destroy(&retro.lock);
+	free(retro.dists);
+	free(retro.hashes);
+	free(retro.configs);
+}
+
+/**
+ * Use the table saved by endgame_generate.
+ */
+void endgame_load(const char *pathname) {
+	size_t size;
+
+	table = map_file(pathname, &size);
+	assert(size >= sizeof(EndgameHeader));
+	assert(memcmp(table->magic, ENDGAME_MAGIC, 8) == 0);
+	assert(size == sizeof(EndgameHeader) + table->count * 9);
+}
+
+bool endgame_loaded(void) {
+	return table != NULL;
+}
+
+/**
+ * Number of single card moves left to win the board, -1 when it has
+ * too many cards in play for the table.
+ */
+int endgame_lookup(Board *board) {
+	long id;
+	const uint64_t *hashes;
+
+	if (56 - board->fdlen[0] - board->fdlen[1] - board->fdlen[2] - board->fdlen[3] > (int) table->cards)
+		return -1;
+
+	hashes = (const uint64_t*) (table + 1);
+	id = endgame_find(hashes, table->count, board->hash);
+	assert(id >= 0);
+	return ((const uint8_t*) (hashes + table->count))[id];
+}
@@ -0,0 +1,16 @@
+#ifndef FREECELL_ENDGAME_H
+#define FREECELL_ENDGAME_H
+
+#include <stdbool.h>
+#include "board.h"
+
+// Most cards left in play the tables can be generated for, the 7 cards
+// table holds about 10M boards
+#define ENDGAME_MAXCARDS 7
+
+void endgame_generate(const char *pathname, int cards);
+void endgame_load(const char *pathname);
+bool endgame_loaded(void);
+int endgame_lookup(Board *board);
+
+#endif
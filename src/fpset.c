@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "fpset.h"
+
+// The empty slot sentinel, a real 0 fingerprint is stored as FPSET_ZERO
+#define FPSET_EMPTY 0
+#define FPSET_ZERO 0x9e3779b97f4a7c15ULL
+
+// Grow the table once it is 3/4 full
+#define FPSET_MAX_LOAD(capacity) ((capacity) / 4 * 3)
+
+static uint64_t fpset_key(uint64_t fingerprint) {
+	return fingerprint == FPSET_EMPTY ? FPSET_ZERO : fingerprint;
+}
+
+/**
+ * Find the slot holding the key or the empty slot where it belongs.
+ */
+static uint64_t* fpset_probe(uint64_t *slots, size_t mask, uint64_t key) {
+	size_t i;
+
+	for (i = key & mask; slots[i] != FPSET_EMPTY && slots[i] != key; i = (i + 1) & mask);
+	return &slots[i];
+}
+
+static void fpset_grow(FpSet *set) {
+	size_t i, mask;
+	uint64_t *slots;
+
+	mask = set->mask * 2 + 1;
+	slots = (uint64_t*)calloc(mask + 1, sizeof(uint64_t));
+	assert(slots != NULL);
+
+	for (i = 0; i <= set->mask; i++) {
+		if (set->slots[i] == FPSET_EMPTY) continue;
+		*fpset_probe(slots, mask, set->slots[i]) = set->slots[i];
+	}
+
+	free(set->slots);
+	set->slots = slots;
+	set->mask = mask;
+}
+
+/**
+ * Allocate a new set, the capacity is rounded up to a power of two.
+ */
+void fpset_new(FpSet **set, size_t capacity) {
+	size_t size;
+
+	for (size = 16; size < capacity; size <<= 1);
+
+	*set = (FpSet*)malloc(sizeof(FpSet));
+	assert(*set != NULL);
+	(*set)->slots = (uint64_t*)calloc(size, sizeof(uint64_t));
+	assert((*set)->slots != NULL);
+	(*set)->mask = size - 1;
+	(*set)->size = 0;
+}
+
+void fpset_destroy(FpSet *set) {
+	free(set->slots);
+	free(set);
+}
+
+/**
+ * Add a fingerprint to the set. Returns false when it was there already.
+ */
+bool fpset_add(FpSet *set, uint64_t fingerprint) {
+	uint64_t key, *slot;
+
+	key = fpset_key(fingerprint);
+	slot = fpset_probe(set->slots, set->mask, key);
+	if (*slot == key) return false;
+
+	*slot = key;
+	if (++set->size > FPSET_MAX_LOAD(set->mask + 1))
+		fpset_grow(set);
+	return true;
+}
+
+/**
+ * Add a fingerprint to the set, safe to call from many threads at once
+ * without any lock: an empty slot is claimed with a compare-and-swap.
+ * Returns false when it was there already, or another thread claimed it
+ * first. The set does not grow: once full it refuses every fingerprint.
+ * The load may go past the maximum by one claim per thread, the probing
+ * still ends on the slots left empty.
+ */
+bool fpset_try_claim(FpSet *set, uint64_t fingerprint) {
+	size_t i;
+	uint64_t key, seen;
+
+	if (fpset_is_full(set)) return false;
+	key = fpset_key(fingerprint);
+	for (i = key & set->mask;; i = (i + 1) & set->mask) {
+		seen = __atomic_load_n(&set->slots[i], __ATOMIC_RELAXED);
+		if (seen == FPSET_EMPTY && __atomic_compare_exchange_n(&set->slots[i],
+				&seen, key, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+		if (seen == key) return false;
+	}
+
+	__atomic_add_fetch(&set->size, 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+/**
+ * Whether a shared set reached its maximum load, fpset_try_claim then
+ * refuses every fingerprint.
+ */
+bool fpset_is_full(FpSet *set) {
+	return __atomic_load_n(&set->size, __ATOMIC_RELAXED) >= FPSET_MAX_LOAD(set->mask + 1);
+}
+
+/**
+ * Determines whether the fingerprint is in the set, safe to call while
+ * other threads claim fingerprints.
+ */
+bool fpset_contains(FpSet *set, uint64_t fingerprint) {
+	size_t i;
+	uint64_t key, seen;
+
+	key = fpset_key(fingerprint);
+	for (i = key & set->mask;; i = (i + 1) & set->mask) {
+		seen = __atomic_load_n(&set->slots[i], __ATOMIC_RELAXED);
+		if (seen == FPSET_EMPTY) return false;
+		if (seen == key) return true;
+	}
+}
+
+size_t fpset_size(FpSet *set) {
+	return set->size;
+}
+
+size_t fpset_capacity(FpSet *set) {
+	return set->mask + 1;
+}
+
+/**
+ * Find the entry holding the key or the empty entry where it belongs.
+ */
+static FpEntry* fpmap_probe(FpEntry *entries, size_t mask, uint64_t key) {
+	size_t i;
+
+	for (i = key & mask; entries[i].fingerprint != FPSET_EMPTY && entries[i].fingerprint != key; i = (i + 1) & mask);
+	return &entries[i];
+}
+
+static void fpmap_grow(FpMap *map) {
+	size_t i, mask;
+	FpEntry *entries;
+
+	mask = map->mask * 2 + 1;
+	entries = (FpEntry*)calloc(mask + 1, sizeof(FpEntry));
+	assert(entries != NULL);
+
+	for (i = 0; i <= map->mask; i++) {
+		if (map->entries[i].fingerprint == FPSET_EMPTY) continue;
+		*fpmap_probe(entries, mask, map->entries[i].fingerprint) = map->entries[i];
+	}
+
+	free(map->entries);
+	map->entries = entries;
+	map->mask = mask;
+}
+
+/**
+ * Allocate a new map, the capacity is rounded up to a power of two.
+ */
+void fpmap_new(FpMap **map, size_t capacity) {
+	size_t size;
+
+	for (size = 16; size < capacity; size <<= 1);
+
+	*map = (FpMap*)malloc(sizeof(FpMap));
+	assert(*map != NULL);
+	(*map)->entries = (FpEntry*)calloc(size, sizeof(FpEntry));
+	assert((*map)->entries != NULL);
+	(*map)->mask = size - 1;
+	(*map)->size = 0;
+}
+
+void fpmap_destroy(FpMap *map) {
+	free(map->entries);
+	free(map);
+}
+
+/**
+ * The value of the fingerprint, NULL when it is not in the map. The
+ * pointer is valid until the next fpmap_put.
+ */
+uint32_t* fpmap_get(FpMap *map, uint64_t fingerprint) {
+	uint64_t key;
+	FpEntry *entry;
+
+	key = fpset_key(fingerprint);
+	entry = fpmap_probe(map->entries, map->mask, key);
+	return entry->fingerprint == key ? &entry->value : NULL;
+}
+
+/**
+ * Set the value of the fingerprint, adding it when it is not there.
+ */
+void fpmap_put(FpMap *map, uint64_t fingerprint, uint32_t value) {
+	uint64_t key;
+	FpEntry *entry;
+
+	key = fpset_key(fingerprint);
+	entry = fpmap_probe(map->entries, map->mask, key);
+	entry->value = value;
+	if (entry->fingerprint == key) return;
+
+	entry->fingerprint = key;
+	if (++map->size > FPSET_MAX_LOAD(map->mask + 1))
+		fpmap_grow(map);
+}
+
+size_t fpmap_size(FpMap *map) {
+	return map->size;
+}
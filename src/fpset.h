@@ -0,0 +1,53 @@
+#ifndef FREECELL_FPSET_H
+#define FREECELL_FPSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Set of 64 bits board fingerprints using open addressing and linear
+ * probing. The fingerprints are stored as-is in a flat power-of-two
+ * array, the 0 value is reserved to mark the empty slots. The sets
+ * shared by threads are filled with fpset_try_claim only.
+ */
+typedef struct fpset {
+	uint64_t *slots;
+	size_t mask;  // capacity - 1
+	size_t size;
+} FpSet;
+
+void fpset_new(FpSet **set, size_t capacity);
+void fpset_destroy(FpSet *set);
+
+bool fpset_add(FpSet *set, uint64_t fingerprint);
+bool fpset_try_claim(FpSet *set, uint64_t fingerprint);
+bool fpset_contains(FpSet *set, uint64_t fingerprint);
+bool fpset_is_full(FpSet *set);
+size_t fpset_size(FpSet *set);
+size_t fpset_capacity(FpSet *set);
+
+/**
+ * Map from fingerprints to a 32 bits value, laid out as an FpSet with
+ * the value next to each fingerprint. It grows as needed, it is not
+ * meant to be shared by threads.
+ */
+typedef struct fpentry {
+	uint64_t fingerprint;
+	uint32_t value;
+} FpEntry;
+
+typedef struct fpmap {
+	FpEntry *entries;
+	size_t mask;  // capacity - 1
+	size_t size;
+} FpMap;
+
+void fpmap_new(FpMap **map, size_t capacity);
+void fpmap_destroy(FpMap *map);
+
+uint32_t* fpmap_get(FpMap *map, uint64_t fingerprint);
+void fpmap_put(FpMap *map, uint64_t fingerprint, uint32_t value);
+size_t fpmap_size(FpMap *map);
+
+#endif
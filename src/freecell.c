@@ -1,198 +1,274 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include "astar.h"
+#include "beam.h"
+#include "bench.h"
+#include "bnb.h"
 #include "board.h"
+#include "deadlock.h"
+#include "endgame.h"
 #include "freecell.h"
-#include "stack.h"
+#include "hda.h"
+#include "ida.h"
+#include "parallel.h"
+#include "pdb.h"
 #include "strategy.h"
 #include "xxhash.h"
-#include "hashset.h"
+#include "fpset.h"
+#include "stats.h"
 
-// Hashset hash function but the object is hashed already
-size_t hash_hashkey(const void *key, int l, uint32_t seed) {
-	return (size_t)key;
+
+void frames_init(Frames *frames) {
+	frames->goals = NULL;
+	frames->depth = 0;
+	frames->capacity = 0;
+	journal_init(&frames->journal);
+}
+
+void frames_destroy(Frames *frames) {
+	free(frames->goals);
+	journal_destroy(&frames->journal);
+	frames_init(frames);
+}
+
+/**
+ * Get a new goal on top of the frames, its moves start at the end of
+ * the journal.
+ */
+Goal* frames_push(Frames *frames) {
+	Goal *goal;
+
+	if (frames->depth == frames->capacity) {
+		frames->capacity = frames->capacity ? frames->capacity * 2 : 256;
+		frames->goals = (Goal*)realloc(frames->goals, frames->capacity * sizeof(Goal));
+		assert(frames->goals != NULL);
+	}
+
+	goal = &frames->goals[frames->depth++];
+	goal->journal = &frames->journal;
+	goal->start = frames->journal.len;
+	goal->strat = STRAT_NULL;
+	return goal;
+}
+
+/**
+ * Replace the goals and moves of dst by a copy of the ones of src.
+ */
+void frames_copy(Frames *dst, Frames *src) {
+	int depth;
+
+	dst->depth = 0;
+	for (depth = 0; depth < src->depth; depth++) {
+		*frames_push(dst) = src->goals[depth];
+		dst->goals[depth].journal = &dst->journal;
+	}
+	journal_copy(&dst->journal, &src->journal);
 }
 
-// Hashset comparison function but the object is hashed already
-int comp_hashkey(const void *k1, const void *k2) {
-	XXH64_hash_t h1 = (XXH64_hash_t)k1;
-	XXH64_hash_t h2 = (XXH64_hash_t)k2;
+/**
+ * Replace the goals of dst by a copy of the ones of src up to the given
+ * depth, with the moves leading to the goal at that depth. The goal
+ * can then resume its strategies from dst.
+ */
+void frames_split(Frames *dst, Frames *src, int depth) {
+	int i;
+
+	assert(depth + 1 < src->depth);
+	dst->depth = 0;
+	for (i = 0; i <= depth; i++) {
+		*frames_push(dst) = src->goals[i];
+		dst->goals[i].journal = &dst->journal;
+	}
+
+	journal_copy(&dst->journal, &src->journal);
+	dst->journal.len = src->goals[depth].start;
+}
 
-	if (h1 < h2) return -1;
-	if (h1 > h2) return 1;
-	return 0;
+/**
+ * Get where the moves of the goal at the given depth end in the journal.
+ */
+int frames_end(Frames *frames, int depth) {
+	return depth + 1 < frames->depth ? frames->goals[depth + 1].start : frames->journal.len;
 }
 
 
-Node* search(Board *board, HashSet *visited) {
-	int strat;
-	Stack *nextmoves;
+bool search(Board *board, FpSet *visited, Frames *frames) {
 	Goal *goal;
-	Node *old_node, *node;
-	Card *fromcard, *tocard;
 	XXH64_hash_t board_hash;
 
-	// There are many strategy sorted in this array by preference, each
-	// index also map to the internal value of the "strat" enum.
-	void (*strategies[])(Board *, Goal *) = {
-			NULL,
-			strat_rule_of_two,
-			strat_build_down,
-			strat_build_empty,
-			strat_access_low_card,
-			strat_access_build_card,
-			strat_access_empty,
-			strat_any_move_cascade,
-			strat_any_move_foundation,
-			strat_any_move_freecell,
-	};
-
-	// Each strategy uses special "initializers" so it is possible to
-	// fast-forward their internal loop when we backtrack. This array
-	// contains the starting values, e.g. "0" in "for (i = 0; i < 10; i++)"
-	int goal_inits[10][2] = {
-			{0, 0},  // STRAT_NULL
-			{0, 0},  // STRAT_RULE_OF_TWO
-			{7, -4},  // STRAT_BUILD_DOWN
-			{11, 0},  // STRAT_BUILD_EMPTY
-			{0, 0},  // STRAT_ACCESS_LOW_CARD
-			{7, 0},  // STRAT_ACCESS_BUILD_CARD
-			{7, 0},  // STRAT_ACCESS_EMPTY
-			{0, -4},  // STRAT_ANY_MOVE_CASCADE
-			{0, 0},  // STRAT_ANY_MOVE_FOUNDATION
-			{0, 0},  // STRAT_ANY_MOVE_FREECELL
-	};
-
-	// The root node has no parent
-	node = NULL;
-
 	RECURSION:;
 	while (!is_game_won(board)) {
 
-		// Create a new node, a new goal and a new move stack. Link them
-		// together and to new node to the old node.
-		old_node = node;
-		node = (Node*)malloc(sizeof(Node));
-		assert(node != NULL);
-		goal = (Goal*)malloc(sizeof(Goal));
-		assert(goal != NULL);
-		assert(stack_new(&nextmoves) == CC_OK);
-		goal->nextmoves = nextmoves;
-		goal->strat = STRAT_NULL;
-		node->parent = old_node;
-		node->goal = goal;
+		// Create a new node on top of the frames
+		goal = frames_push(frames);
+		stats.nodes++;
 
 		// Recompute the various board properties
-		compute_sortdepth(board);
-		compute_buildfactor(board);
-
-		// Test all strategies on un-visited boards
-		board_hash = XXH3_64bits(board, offsetof(Board, fdlen));
-		if (!hashset_contains(visited, (void*)board_hash)) {
-			assert(hashset_add(visited, (void*)board_hash) == CC_OK);
-
-			for (strat = 1; strat < 10; strat++) {
-				goal->a = goal_inits[strat][0];
-				goal->b = goal_inits[strat][1];
-				RECURSION_RETURN:;
-				strategies[strat](board, goal);
-				if (goal->strat != STRAT_NULL) {
-					// MATCH! Re-search on the modified board. If the
-					// sub-search fails, we want to resume the current
-					// strategy, we go back to RECURSION_RETURN.
-					goto RECURSION;
-				}
+		compute_properties(board);
+
+		// Test all strategies on un-visited boards that can still be won
+		board_hash = board->hash;
+		if (is_deadlocked(board)) {
+			stats.deadlocks++;
+		} else if (fpset_add(visited, board_hash)) {
+			stats.visited++;
+			RECURSION_RETURN:;
+			if (strat_next(board, goal) != STRAT_NULL) {
+				// MATCH! Re-search on the modified board. If the
+				// sub-search fails, we want to resume the current
+				// strategy, we go back to RECURSION_RETURN.
+				goto RECURSION;
 			}
 		}
 
 		// Board fully visited, no strategy worked, restore the previous node state
-		assert(!stack_size(nextmoves));
-		stack_destroy(nextmoves);
-		free(node->goal);
-		old_node = node;
-		node = node->parent;
-		free(old_node);
+		assert(goal->start == frames->journal.len);
+		frames->depth--;
 
 		// The game is impossible, we backtracked above the root node
-		if (!node) return NULL;
-
-		goal = node->goal;
-		nextmoves = goal->nextmoves;
+		if (!frames->depth) return false;
 
 		// Restore the board too
-		while (stack_size(nextmoves)) {
-			assert(stack_pop(nextmoves, (void**)&fromcard) == CC_OK);
-			assert(stack_pop(nextmoves, (void**)&tocard) == CC_OK);
-			move(board, fromcard, tocard);
-		}
+		goal = &frames->goals[frames->depth - 1];
+		journal_undo(&frames->journal, board, goal->start);
 		// Recompute the various board properties
-		compute_sortdepth(board);
-		compute_buildfactor(board);
+		compute_properties(board);
 
 		// Continue searching using the previous (now current) node next's strategy
-		strat = (int)goal->strat;
-		goal->strat = STRAT_NULL;
 		goto RECURSION_RETURN;
 	}
 
 	// The game is solved !
-	return node;
+	return true;
 }
 
 int main(int argc, char *argv[]) {
 	Board board;
-	Node *leaf, *old_leaf;
+	Frames frames;
+	Goal *goal;
 	Card *fromcard;
 	Card *tocard;
-	HashSet *visited;
-	HashSetConf conf;
+	Move m;
+	FpSet *visited;
 	char fromcardstr[4] = "   ";
 	char tocardstr[4] = "   ";
 	char movestr[3] = "  ";
-	bool won = false;
-	int moves_cnt;
+	bool won = false, full = false;
+	int i, opt, moves_cnt;
+	int width = 1000, target = 0, threads = 1;
+	unsigned long budget = 0;
+	double weight = 1;
+	const char *engine = "dfs";
+	const char *bench = NULL;
+	const char *pdbpath = NULL;
+	const char *endgame = NULL;
+	int endgame_cards = 6;
 	XXH64_hash_t board_footprint;
 
 	// Initiate an empty board
 	board_init(&board);
 
-	if (argc == 1) {
-		printf("usage: %s <seed>\n	   %s _ <path>\n", argv[0], argv[0]);
-		return 1;
-	} else if (argc == 2) {
-		srand(strtol(argv[1], NULL, 10));
+	while ((opt = getopt(argc, argv, "b:c:e:g:j:k:n:p:r:t:w:x:")) != -1) {
+		switch (opt) {
+			case 'b': bench = optarg; break;
+			case 'c': endgame_cards = strtol(optarg, NULL, 10); break;
+			case 'e': engine = optarg; break;
+			case 'g': pdb_generate(optarg); return 0;
+			case 'j': threads = strtol(optarg, NULL, 10); break;
+			case 'k': width = strtol(optarg, NULL, 10); break;
+			case 'n': budget = strtoul(optarg, NULL, 10); break;
+			case 'p': pdbpath = optarg; break;
+			case 'r': endgame = optarg; break;
+			case 't': target = strtol(optarg, NULL, 10); break;
+			case 'w': weight = strtod(optarg, NULL); break;
+			case 'x': endgame_load(optarg); break;
+			default: argc = optind = 0;
+		}
+	}
+
+	if (endgame) {
+		endgame_generate(endgame, endgame_cards);
+		return 0;
+	}
+
+	if (argc - optind == 1) {
+		srand(strtol(argv[optind], NULL, 10));
 		board_deal(&board);
-		printf("Seed: %s\n\n", argv[1]);
-	} else if (argc == 3) {
-		board_load(&board, argv[2]);
-		printf("File: %s\n\n", argv[2]);
+		printf("Seed: %s\n\n", argv[optind]);
+	} else if (argc - optind == 2) {
+		board_load(&board, argv[optind + 1]);
+		printf("File: %s\n\n", argv[optind + 1]);
+	} else {
+		printf("usage: %s [options] <seed>\n	   %s [options] _ <path>\n", argv[0], argv[0]);
+		printf("options:\n");
+		printf("  -b bench   measure movegen or fpset instead of solving\n");
+		printf("  -c cards   left in play in the generated endgame table (6)\n");
+		printf("  -e engine  dfs (default), astar, ida, beam, bnb or hda\n");
+		printf("  -g path    generate the pattern database and exit\n");
+		printf("  -j threads searching with dfs or hda (1)\n");
+		printf("  -k width   boards kept per layer by beam (1000)\n");
+		printf("  -n budget  boards expanded before astar, beam, bnb or hda give up\n");
+		printf("  -p path    guide astar and beam with a pattern database\n");
+		printf("  -r path    generate the endgame table and exit\n");
+		printf("  -t target  solutions must be shorter for bnb\n");
+		printf("  -w weight  of the heuristic for astar, beam and hda (1)\n");
+		printf("  -x path    finish the endgames with the table\n");
+		return 1;
 	}
 	board_footprint = XXH3_64bits(&board, offsetof(Board, fdlen));
 
-	/* Initiate a "have this board been visited before ?" hashset.
+	if (pdbpath) pdb_load(pdbpath);
+
+	if (bench) {
+		if (!strcmp(bench, "fpset")) {
+			bench_fpset(MAX(1, sysconf(_SC_NPROCESSORS_ONLN)));
+			return 0;
+		}
+		assert(!strcmp(bench, "movegen"));
+		bench_movegen(&board);
+		assert(XXH3_64bits(&board, offsetof(Board, fdlen)) == board_footprint);
+		return 0;
+	}
+
+	/* Initiate a "have this board been visited before ?" set.
 	 * Because the board itself is mutable, it is unsafe to use it
-	 * as hash key. We instead manually hash the board to "freeze"
-	 * it. The hash key is a hash already, the above hash_hashkey
-	 * and comp_hashkey functions just passthrough the manually
-	 * computed hash and compare the hash directly (there is no
-	 * re-hash like in a "normal" hashset). */
-	hashset_conf_init(&conf);
-	conf.hash = hash_hashkey;
-	conf.key_compare = comp_hashkey;
-	conf.initial_capacity = 1 << 20;  // 1M
-	hashset_new_conf(&conf, &visited);
+	 * as key. We instead manually hash the board to "freeze" it,
+	 * the set only stores those 64 bits fingerprints. */
+	fpset_new(&visited, 1 << 16);  // 64K, grows as needed
 
 	// Show the initial board than search for a solution
 	board_show(&board);
-	leaf = search(&board, visited);
+	frames_init(&frames);
+	if (!strcmp(engine, "astar")) won = astar(&board, &frames, weight, budget);
+	else if (!strcmp(engine, "ida")) won = ida(&board, &frames);
+	else if (!strcmp(engine, "hda")) won = hda(&board, &frames, threads, weight, budget);
+	else if (!strcmp(engine, "bnb")) won = bnb(&board, &frames, target, budget);
+	else if (!strcmp(engine, "beam")) {
+		won = beam(&board, &frames, width, weight, budget);
+		if (!won) {
+			printf("Beam search failed, falling back on depth-first search.\n");
+			won = search(&board, visited, &frames);
+		}
+	}
+	else {
+		assert(!strcmp(engine, "dfs"));
+		if (threads > 1) won = parallel_search(&board, &frames, threads, &full);
+		else won = search(&board, visited, &frames);
+	}
+	stats_show();
 
-	if (is_game_won(&board)) {
-		won = true;
+	if (won) {
 		printf("Game solved! Most recent move first.\n");
 		moves_cnt = 0;
-		while (leaf) {
-			switch (leaf->goal->strat) {
+		while (frames.depth) {
+			goal = &frames.goals[--frames.depth];
+			switch (goal->strat) {
+				case STRAT_AUTO_WIN: printf("Auto win:\n"); break;
+				case STRAT_ENDGAME: printf("Endgame table:\n"); break;
 				case STRAT_RULE_OF_TWO: printf("Rule of two:\n"); break;
 				case STRAT_BUILD_DOWN: printf("Build down:\n"); break;
 				case STRAT_BUILD_EMPTY: printf("Build empty:\n"); break;
@@ -204,39 +280,36 @@ int main(int argc, char *argv[]) {
 				case STRAT_ANY_MOVE_FREECELL: printf("Move any card(s) to the freecells:\n"); break;
 				default: assert(0);
 			}
-			moves_cnt += stack_size(leaf->goal->nextmoves);
-			while (stack_size(leaf->goal->nextmoves)) {
-				stack_pop(leaf->goal->nextmoves, (void**)&tocard);
-				stack_pop(leaf->goal->nextmoves, (void**)&fromcard);
+			for (i = frames_end(&frames, frames.depth) - 1; i >= goal->start; i--) {
+				m = frames.journal.moves[i];
+				fromcard = (Card*) &board + MOVE_FROM(m);
+				tocard = (Card*) &board + MOVE_TO(m);
 				move(&board, tocard, fromcard);
+				moves_cnt++;
 				setcardstr(*fromcard, fromcardstr);
 				if (tocard < (Card*)board.foundation) {
-					assert(is_move_valid(*fromcard, *tocard, 'f'));
+					assert(is_nullcard(*tocard));
 					setcardstr(*tocard, tocardstr);
 				} else if (tocard < (Card*)board.cascade) {
-					assert(is_move_valid(*fromcard, *(tocard - 1), 'h'));
+					assert(can_home(&board, *fromcard));
 					setcardstr(*(tocard - 1), tocardstr);
 				} else {
-					assert(is_move_valid(*fromcard, *(tocard - 1), 'c'));
+					assert(can_build(*fromcard, *(tocard - 1)));
 					setcardstr(*(tocard - 1), tocardstr);
 				}
 				setmovestr(&board, fromcard, tocard, movestr);
 				printf("  %s: %s -> %s\n", movestr, fromcardstr, tocardstr);
 			}
-			stack_destroy(leaf->goal->nextmoves);
-			free(leaf->goal);
-			old_leaf = leaf;
-			leaf = leaf->parent;
-			free(old_leaf);
+			frames.journal.len = goal->start;
 		}
 		assert(XXH3_64bits(&board, offsetof(Board, fdlen)) == board_footprint);
 		printf("Solution in %d steps.\n", moves_cnt);
 	} else {
-		printf("Game is unsolvable.\n");
+		printf(budget || target || full ? "No solution within the budget.\n" : "Game is unsolvable.\n");
 	}
 
-	hashset_remove_all(visited);
-	hashset_destroy(visited);
+	frames_destroy(&frames);
+	fpset_destroy(visited);
 
 	return won ? 0 : 1;
 }
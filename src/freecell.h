@@ -4,15 +4,29 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "board.h"
-#include "stack.h"
 #include "strategy.h"
-#include "hashset.h"
+#include "fpset.h"
 
-typedef struct node {
-	struct node *parent;
-	Goal *goal;
-} Node;
+/**
+ * The search is depth-first, one goal per depth is kept in a growable
+ * array, the parent of a goal is the previous one in the array. The
+ * moves of all the goals are stored one after the other in a same
+ * journal.
+ */
+typedef struct frames {
+	Goal *goals;
+	int depth;
+	int capacity;
+	Journal journal;
+} Frames;
 
-Node* search(Board *board, HashSet *visited);
+void frames_init(Frames *frames);
+void frames_destroy(Frames *frames);
+Goal* frames_push(Frames *frames);
+void frames_copy(Frames *dst, Frames *src);
+void frames_split(Frames *dst, Frames *src, int depth);
+int frames_end(Frames *frames, int depth);
+
+bool search(Board *board, FpSet *visited, Frames *frames);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,451 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "astar.h"
+#include "board.h"
+#include "bucketq.h"
+#include "fpset.h"
+#include "freecell.h"
+#include "hda.h"
+#include "heuristic.h"
+#include "stats.h"
+#include "strategy.h"
+
+// Boards sent at once to a thread
+#define HDA_BATCH 64
+
+// Expansions between two flushes of the partial batches
+#define HDA_FLUSH 256
+
+/* Hash distributed A*. Each board belongs to the thread given by its
+ * Zobrist key, that thread alone keeps it in its open list and closed
+ * set. The children generated by a thread are sent to their owner in
+ * batches through a lock-free queue with many producers and a single
+ * consumer, so no table is shared.
+ *
+ * The search goes on after a win until no open board can lead to a
+ * shorter solution, with weight 1 it is the one astar finds. Higher
+ * weights stop on the first win. It is over once every thread is idle
+ * and no batch is on its way. */
+
+/**
+ * A board sent to its owner.
+ */
+typedef struct message {
+	Node node;
+	uint64_t hash;
+	int f;
+} Message;
+
+typedef struct batch {
+	struct batch *next;
+	int len;
+	Message messages[HDA_BATCH];
+} Batch;
+
+/**
+ * Intrusive queue: the producers swap the head, the consumer follows
+ * the next links from the tail. The stub keeps it never empty.
+ */
+typedef struct inbox {
+	Batch *head;
+	Batch *tail;
+	Batch stub;
+	long pending;  // messages pushed and not popped yet
+} Inbox;
+
+struct hda;
+
+typedef struct hda_worker {
+	struct hda *hda;
+	int id;
+	Nodes nodes;
+	BucketQ *open;
+	FpMap *closed;  // lowest g each board was expanded with
+	Inbox inbox;
+	Batch *outbox[HDA_MAXTHREADS];
+	unsigned long expanded;
+	unsigned long sent;
+	unsigned long received;
+	unsigned long duplicates;
+	Stats stats;
+	pthread_t thread;
+} HdaWorker;
+
+typedef struct hda {
+	HdaWorker *workers;
+	int threads;
+	double weight;
+	unsigned long budget;
+
+	pthread_mutex_t lock;
+	int idle;
+	bool done;  // read without the lock
+	int best;  // g of the best win, read without the lock
+	uint32_t winner;
+} Hda;
+
+static void inbox_init(Inbox *inbox) {
+	inbox->stub.next = NULL;
+	inbox->head = inbox->tail = &inbox->stub;
+	inbox->pending = 0;
+}
+
+static void inbox_push(Inbox *inbox, Batch *batch) {
+	Batch *prev;
+
+	__atomic_store_n(&batch->next, NULL, __ATOMIC_RELAXED);
+	prev = __atomic_exchange_n(&inbox->head, batch, __ATOMIC_ACQ_REL);
+	__atomic_store_n(&prev->next, batch, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the oldest batch, NULL when there is none or a producer did not
+ * finish to link it yet. Only the owner thread may call it.
+ */
+static Batch* inbox_pop(Inbox *inbox) {
+	Batch *tail, *next;
+
+	tail = inbox->tail;
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (tail == &inbox->stub) {
+		if (!next) return NULL;
+		inbox->tail = tail = next;
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	}
+	if (next) {
+		inbox->tail = next;
+		return tail;
+	}
+	if (tail != __atomic_load_n(&inbox->head, __ATOMIC_ACQUIRE)) return NULL;
+
+	// Put the stub back behind the last batch to pop it
+	inbox_push(inbox, &inbox->stub);
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (!next) return NULL;
+	inbox->tail = next;
+	return tail;
+}
+
+static int hda_owner(Hda *hda, uint64_t hash) {
+	return (hash >> 32) % hda->threads;
+}
+
+/**
+ * Send the partial batch of the worker to a thread.
+ */
+static void hda_flush(HdaWorker *worker, int to) {
+	Batch *batch;
+	Inbox *inbox;
+
+	batch = worker->outbox[to];
+	if (!batch) return;
+	worker->outbox[to] = NULL;
+	worker->sent += batch->len;
+	inbox = &worker->hda->workers[to].inbox;
+	__atomic_add_fetch(&inbox->pending, batch->len, __ATOMIC_RELEASE);
+	inbox_push(inbox, batch);
+}
+
+static void hda_flush_all(HdaWorker *worker) {
+	int to;
+
+	for (to = 0; to < worker->hda->threads; to++)
+		hda_flush(worker, to);
+}
+
+/**
+ * Queue a board in the open list of the worker unless it was expanded
+ * with as few moves or cannot beat the best win.
+ */
+static void hda_open(HdaWorker *worker, Node *node, uint64_t hash, int f) {
+	uint32_t *closed;
+
+	if (f >= __atomic_load_n(&worker->hda->best, __ATOMIC_RELAXED)) return;
+	closed = fpmap_get(worker->closed, hash);
+	if (closed && *closed <= node->g) {
+		worker->duplicates++;
+		return;
+	}
+	assert(worker->nodes.len < 1U << (32 - HDA_THREAD_BITS));
+	bucketq_push(worker->open, f, nodes_copy(&worker->nodes, node) << HDA_THREAD_BITS | worker->id);
+}
+
+/**
+ * Open the boards received by the worker.
+ */
+static void hda_receive(HdaWorker *worker) {
+	int i;
+	Batch *batch;
+
+	while ((batch = inbox_pop(&worker->inbox))) {
+		for (i = 0; i < batch->len; i++)
+			hda_open(worker, &batch->messages[i].node, batch->messages[i].hash, batch->messages[i].f);
+		__atomic_sub_fetch(&worker->inbox.pending, batch->len, __ATOMIC_RELAXED);
+		worker->received += batch->len;
+		free(batch);
+	}
+}
+
+/**
+ * Send the child on the board to its owner.
+ */
+static void hda_send(HdaWorker *worker, Board *board, uint32_t parent, int g, int f) {
+	int to;
+	Node node;
+	Message *message;
+	Batch *batch;
+
+	to = hda_owner(worker->hda, board->hash);
+	if (to == worker->id) {
+		board_pack(board, node.packed);
+		node.parent = parent;
+		node.g = g;
+		hda_open(worker, &node, board->hash, f);
+		return;
+	}
+
+	batch = worker->outbox[to];
+	if (!batch) {
+		batch = worker->outbox[to] = (Batch*)malloc(sizeof(Batch));
+		assert(batch != NULL);
+		batch->len = 0;
+	}
+	message = &batch->messages[batch->len++];
+	board_pack(board, message->node.packed);
+	message->node.parent = parent;
+	message->node.g = g;
+	message->hash = board->hash;
+	message->f = f;
+	if (batch->len == HDA_BATCH) hda_flush(worker, to);
+}
+
+/**
+ * Wait for boards once the open list is empty, returns false when the
+ * search is over.
+ */
+static bool hda_wait(HdaWorker *worker) {
+	int i, err;
+	long pending;
+	Hda *hda = worker->hda;
+
+	hda_flush_all(worker);
+	err = pthread_mutex_lock(&hda->lock);
+	assert(err == 0);
+	hda->idle++;
+	for (pending = 0, i = 0; i < hda->threads; i++)
+		pending += __atomic_load_n(&hda->workers[i].inbox.pending, __ATOMIC_ACQUIRE);
+	if (hda->idle == hda->threads && !pending)
+		__atomic_store_n(&hda->done, true, __ATOMIC_RELAXED);
+	err = pthread_mutex_unlock(&hda->lock);
+	assert(err == 0);
+
+	while (!__atomic_load_n(&hda->done, __ATOMIC_RELAXED)) {
+		if (__atomic_load_n(&worker->inbox.pending, __ATOMIC_ACQUIRE)) {
+			err = pthread_mutex_lock(&hda->lock);
+			assert(err == 0);
+			hda->idle--;
+			err = pthread_mutex_unlock(&hda->lock);
+			assert(err == 0);
+			return true;
+		}
+		sched_yield();
+	}
+	return false;
+}
+
+static void* hda_work(void *arg) {
+	uint32_t id, *closed;
+	int g, err;
+	Board board;
+	Goal goal;
+	Journal journal;
+	Node *node;
+	HdaWorker *worker = arg;
+	Hda *hda = worker->hda;
+
+	journal_init(&journal);
+	goal.journal = &journal;
+
+	while (!__atomic_load_n(&hda->done, __ATOMIC_RELAXED)) {
+		hda_receive(worker);
+		if (!bucketq_pop(worker->open, &id)) {
+			if (!hda_wait(worker)) break;
+			continue;
+		}
+
+		node = &worker->nodes.nodes[id >> HDA_THREAD_BITS];
+		g = node->g;
+		if (g >= __atomic_load_n(&hda->best, __ATOMIC_RELAXED)) continue;
+		board_unpack(&board, node->packed);
+		stats.nodes++;
+
+		// The boards are expanded again when reached by a shorter path,
+		// the threads do not expand them in the f order
+		closed = fpmap_get(worker->closed, board.hash);
+		if (closed && (int) *closed <= g) {
+			worker->duplicates++;
+			continue;
+		}
+		if (closed) {
+			stats.reexpanded++;
+			*closed = g;
+		} else {
+			fpmap_put(worker->closed, board.hash, g);
+		}
+		stats.visited++;
+		worker->expanded++;
+		if (worker->expanded % HDA_FLUSH == 0) hda_flush_all(worker);
+		if (hda->budget && worker->expanded * hda->threads >= hda->budget)
+			__atomic_store_n(&hda->done, true, __ATOMIC_RELAXED);
+
+		if (is_game_won(&board)) {
+			err = pthread_mutex_lock(&hda->lock);
+			assert(err == 0);
+			if (g < hda->best) {
+				__atomic_store_n(&hda->best, g, __ATOMIC_RELAXED);
+				hda->winner = id;
+			}
+			if (hda->weight != 1) __atomic_store_n(&hda->done, true, __ATOMIC_RELAXED);
+			err = pthread_mutex_unlock(&hda->lock);
+			assert(err == 0);
+			continue;
+		}
+
+		// Send all the children to their owners
+		compute_properties(&board);
+		goal.start = 0;
+		goal.strat = STRAT_NULL;
+		while (strat_next(&board, &goal) != STRAT_NULL) {
+			hda_send(worker, &board, id, g + journal.len,
+					g + journal.len + (int) (hda->weight * estimate(&board)));
+			journal_undo(&journal, &board, 0);
+			compute_properties(&board);
+		}
+	}
+
+	// Batches left behind by a win or the budget
+	hda_flush_all(worker);
+	journal_destroy(&journal);
+	worker->stats = stats;
+	return NULL;
+}
+
+/**
+ * Copy the nodes from the root to the last one out of the threads that
+ * own them.
+ */
+static void hda_path(Hda *hda, Nodes *path, uint32_t last) {
+	int i;
+	uint32_t id;
+	Node *node, swap;
+
+	// Walk up to the root then put the nodes back in order
+	for (id = last;; id = node->parent) {
+		node = &hda->workers[id & (HDA_MAXTHREADS - 1)].nodes.nodes[id >> HDA_THREAD_BITS];
+		nodes_copy(path, node);
+		if (node->parent == id) break;
+	}
+	for (i = 0; i < (int) path->len / 2; i++) {
+		swap = path->nodes[i];
+		path->nodes[i] = path->nodes[path->len - 1 - i];
+		path->nodes[path->len - 1 - i] = swap;
+	}
+	for (i = 0; i < (int) path->len; i++)
+		path->nodes[i].parent = MAX(0, i - 1);
+}
+
+/**
+ * Best-first search as astar() does, spread over the given number of
+ * threads.
+ */
+bool hda(Board *board, Frames *frames, int threads, double weight, unsigned long budget) {
+	int i, root, err;
+	uint32_t id;
+	double elapsed;
+	unsigned long messages, expanded, most;
+	struct timespec start, end;
+	Hda hda;
+	HdaWorker *worker;
+	Nodes path;
+	Batch *batch;
+
+	assert(threads >= 1 && threads <= HDA_MAXTHREADS);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	hda.threads = threads;
+	hda.weight = weight;
+	hda.budget = budget;
+	hda.idle = 0;
+	hda.done = false;
+	hda.best = INT_MAX;
+	err = pthread_mutex_init(&hda.lock, NULL);
+	assert(err == 0);
+	hda.workers = (HdaWorker*)calloc(threads, sizeof(HdaWorker));
+	assert(hda.workers != NULL);
+	for (i = 0; i < threads; i++) {
+		worker = &hda.workers[i];
+		worker->hda = &hda;
+		worker->id = i;
+		nodes_init(&worker->nodes);
+		bucketq_new(&worker->open);
+		fpmap_new(&worker->closed, 1 << 16);  // grows as needed
+		inbox_init(&worker->inbox);
+	}
+
+	// The root is its own parent
+	root = hda_owner(&hda, board->hash);
+	id = nodes_push(&hda.workers[root].nodes, board, 0, 0) << HDA_THREAD_BITS | root;
+	hda.workers[root].nodes.nodes[0].parent = id;
+	bucketq_push(hda.workers[root].open, (int) (weight * estimate(board)), id);
+
+	for (i = 0; i < threads; i++) {
+		err = pthread_create(&hda.workers[i].thread, NULL, hda_work, &hda.workers[i]);
+		assert(err == 0);
+	}
+	for (i = 0; i < threads; i++) {
+		err = pthread_join(hda.workers[i].thread, NULL);
+		assert(err == 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	for (messages = expanded = most = 0, i = 0; i < threads; i++) {
+		worker = &hda.workers[i];
+		printf("Thread %d: %lu expanded (%lu again), %lu sent, %lu received, %lu duplicates\n",
+				i, worker->expanded, worker->stats.reexpanded, worker->sent, worker->received,
+				worker->duplicates);
+		messages += worker->sent;
+		expanded += worker->expanded;
+		most = MAX(most, worker->expanded);
+		stats_add(&stats, &worker->stats);
+		stats.states += worker->nodes.len;
+	}
+	// The load balance is the mean expansions over the most of a thread
+	printf("Messages: %lu in %.3fs, %.0f messages/s, load balance: %.2f\n",
+			messages, elapsed, messages / elapsed,
+			most ? (double) expanded / threads / most : 1.0);
+
+	if (hda.best != INT_MAX) {
+		nodes_init(&path);
+		hda_path(&hda, &path, hda.winner);
+		nodes_path(&path, path.len - 1, board, frames);
+		nodes_destroy(&path);
+	}
+
+	for (i = 0; i < threads; i++) {
+		worker = &hda.workers[i];
+		while ((batch = inbox_pop(&worker->inbox))) free(batch);
+		nodes_destroy(&worker->nodes);
+		bucketq_destroy(worker->open);
+		fpmap_destroy(worker->closed);
+	}
+	free(hda.workers);
+	pthread_mutex_destroy(&hda.lock);
+	return hda.best != INT_MAX;
+}
@@ -0,0 +1,14 @@
+#ifndef FREECELL_HDA_H
+#define FREECELL_HDA_H
+
+#include <stdbool.h>
+#include "board.h"
+#include "freecell.h"
+
+// The node indexes keep the owner thread in their low bits
+#define HDA_THREAD_BITS 6
+#define HDA_MAXTHREADS (1 << HDA_THREAD_BITS)
+
+bool hda(Board *board, Frames *frames, int threads, double weight, unsigned long budget);
+
+#endif
@@ -0,0 +1,26 @@
+#include "board.h"
+#include "heuristic.h"
+#include "pdb.h"
+
+/**
+ * Lower bound of the moves left to win. Every card that is not on the
+ * foundation needs at least one move, the cards stacked on a lower card
+ * of their suit need another one to let it go first.
+ */
+int heuristic(Board *board) {
+	int col, h;
+
+	compute_properties(board);
+	h = 56 - board->fdlen[0] - board->fdlen[1] - board->fdlen[2] - board->fdlen[3];
+	for (col = 0; col < 8; col++)
+		h += board->buried[col];
+	return h;
+}
+
+/**
+ * Guess of the moves left to win for the best-first engines, the
+ * pattern database when one is loaded, the lower bound otherwise.
+ */
+int estimate(Board *board) {
+	return pdb_loaded() ? pdb_lookup(board) : heuristic(board);
+}
@@ -0,0 +1,9 @@
+#ifndef FREECELL_HEURISTIC_H
+#define FREECELL_HEURISTIC_H
+
+#include "board.h"
+
+int heuristic(Board *board);
+int estimate(Board *board);
+
+#endif
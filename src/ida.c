@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include "board.h"
+#include "freecell.h"
+#include "heuristic.h"
+#include "ida.h"
+#include "stats.h"
+#include "strategy.h"
+#include "ttable.h"
+
+/**
+ * Determines whether the board must be expanded in this iteration, it
+ * is not when it was already reached with fewer or as many moves.
+ */
+static bool ida_enter(TTable *table, uint64_t fingerprint, int g, int bound) {
+	TEntry *entry;
+
+	entry = ttable_probe(table, fingerprint);
+	if (entry && entry->bound == bound && entry->g <= g) return false;
+	if (entry && entry->bound < bound) stats.reexpanded++;
+	ttable_store(table, fingerprint, g, bound);
+	return true;
+}
+
+/**
+ * Depth-first search of the boards whose f = g + h is within the bound,
+ * the lowest f above it is saved in next_bound.
+ */
+static bool ida_iteration(Board *board, Frames *frames, TTable *table, int bound, int *next_bound) {
+	int f;
+	Goal *goal;
+
+	RECURSION:;
+	while (!is_game_won(board)) {
+
+		// Create a new node on top of the frames
+		goal = frames_push(frames);
+		stats.nodes++;
+		compute_properties(board);
+
+		f = frames->journal.len + heuristic(board);
+		if (f > bound) {
+			*next_bound = MIN(*next_bound, f);
+		} else if (ida_enter(table, board->hash, frames->journal.len, bound)) {
+			stats.visited++;
+			RECURSION_RETURN:;
+			if (strat_next(board, goal) != STRAT_NULL)
+				goto RECURSION;
+		}
+
+		// Backtrack
+		assert(goal->start == frames->journal.len);
+		frames->depth--;
+		if (!frames->depth) return false;
+
+		goal = &frames->goals[frames->depth - 1];
+		journal_undo(&frames->journal, board, goal->start);
+		compute_properties(board);
+		goto RECURSION_RETURN;
+	}
+
+	return true;
+}
+
+/**
+ * Iterative deepening A*, the depth-first search is repeated with a
+ * higher bound until the game is won. The transposition table keeps the
+ * boards already explored so they are not searched again through a
+ * longer path.
+ */
+bool ida(Board *board, Frames *frames) {
+	int bound, next_bound;
+	unsigned long nodes;
+	bool won;
+	TTable *table;
+
+	ttable_new(&table, TTABLE_DEFAULT_SIZE);
+
+	compute_properties(board);
+	bound = heuristic(board);
+	for (;;) {
+		nodes = stats.nodes;
+		next_bound = INT_MAX;
+		won = ida_iteration(board, frames, table, bound, &next_bound);
+		printf("Bound %d: %lu nodes\n", bound, stats.nodes - nodes);
+		if (won || next_bound == INT_MAX) break;
+		bound = next_bound;
+	}
+
+	ttable_destroy(table);
+	return won;
+}
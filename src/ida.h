@@ -0,0 +1,10 @@
+#ifndef FREECELL_IDA_H
+#define FREECELL_IDA_H
+
+#include <stdbool.h>
+#include "board.h"
+#include "freecell.h"
+
+bool ida(Board *board, Frames *frames);
+
+#endif
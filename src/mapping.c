@@ -0,0 +1,27 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mapping.h"
+
+/**
+ * Map a table file read-only, the pages are shared with every process
+ * using the same file. Sets size to the file size.
+ */
+const void* map_file(const char *pathname, size_t *size) {
+	int fd, err;
+	off_t end;
+	void *map;
+
+	fd = open(pathname, O_RDONLY);
+	assert(fd > 2);
+	end = lseek(fd, 0, SEEK_END);
+	assert(end > 0);
+	*size = end;
+	map = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	assert(map != MAP_FAILED);
+	err = close(fd);
+	assert(err == 0);
+	return map;
+}
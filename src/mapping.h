@@ -0,0 +1,8 @@
+#ifndef FREECELL_MAPPING_H
+#define FREECELL_MAPPING_H
+
+#include <stddef.h>
+
+const void* map_file(const char *pathname, size_t *size);
+
+#endif
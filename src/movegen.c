@@ -0,0 +1,90 @@
+#include <assert.h>
+#include "board.h"
+#include "movegen.h"
+
+/**
+ * Save every legal single card move in the array (of MAXMOVES moves),
+ * returns their count. The moves between two freecells are skipped,
+ * they do not change the board. The empty freecells are all the same
+ * so are the empty cascades, only the first of each is a destination.
+ */
+int gen_moves(Board *board, Move *moves) {
+	int len, from, to, suit, freecell, empty;
+	Card *fromcard, *tocard;
+
+	for (freecell = 0; freecell < 4 && !is_nullcard(board->freecell[freecell]); freecell++);
+	for (empty = 0; empty < 8 && !is_empty(board, empty); empty++);
+
+	len = 0;
+	for (from = 0; from < 12; from++) {
+		fromcard = from < 4 ? &board->freecell[from] : bottom_card(board, from - 4);
+		if (is_nullcard(*fromcard)) continue;
+
+		// To the foundation
+		if (can_home(board, *fromcard)) {
+			suit = SUIT(*fromcard);
+			tocard = &board->foundation[suit][board->fdlen[suit]];
+			moves[len++] = MOVE(fromcard - (Card*) board, tocard - (Card*) board);
+		}
+
+		// To a freecell
+		if (from >= 4 && freecell < 4) {
+			tocard = &board->freecell[freecell];
+			moves[len++] = MOVE(fromcard - (Card*) board, tocard - (Card*) board);
+		}
+
+		// To a cascade
+		for (to = 0; to < 8; to++) {
+			if (to == from - 4) continue;
+			if (to > empty && is_empty(board, to)) continue;
+			tocard = bottom_card(board, to);
+			if (!can_build(*fromcard, *tocard)) continue;
+			moves[len++] = MOVE(fromcard - (Card*) board, tocard + 1 - (Card*) board);
+		}
+	}
+
+	assert(len <= MAXMOVES);
+	return len;
+}
+
+/**
+ * Save every legal move of two or more sorted cards between cascades in
+ * the array (of MAXMULTIMOVES moves), returns their count. The board
+ * properties must be up to date. Only the first empty cascade is a
+ * destination.
+ */
+int gen_multimoves(Board *board, MultiMove *moves) {
+	int len, fromcol, tocol, depth, empty;
+
+	for (empty = 0; empty < 8 && !is_empty(board, empty); empty++);
+
+	len = 0;
+	for (fromcol = 0; fromcol < 8; fromcol++) {
+		if (board->sortdepth[fromcol] < 2) continue;
+
+		for (tocol = 0; tocol < 8; tocol++) {
+			if (tocol == fromcol) continue;
+			if (tocol > empty && is_empty(board, tocol)) continue;
+
+			// Any depth on an empty cascade, a single one otherwise
+			if (is_empty(board, tocol)) {
+				depth = board->sortdepth[fromcol];
+			} else {
+				depth = supermove_depth(board, fromcol, tocol);
+				if (depth < 2) continue;
+			}
+
+			for (; depth >= 2; depth--) {
+				if (can_supermove(board, fromcol, tocol, depth)) {
+					moves[len].fromcol = fromcol;
+					moves[len].tocol = tocol;
+					moves[len++].card_cnt = depth;
+				}
+				if (!is_empty(board, tocol)) break;
+			}
+		}
+	}
+
+	assert(len <= MAXMULTIMOVES);
+	return len;
+}
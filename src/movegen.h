@@ -0,0 +1,26 @@
+#ifndef FREECELL_MOVEGEN_H
+#define FREECELL_MOVEGEN_H
+
+#include <stdint.h>
+#include "board.h"
+
+// The 4 freecells to the foundation and 8 cascades, the 8 cascades to
+// the foundation, 4 freecells and 7 other cascades
+#define MAXMOVES (4 * (1 + 8) + 8 * (1 + 4 + 7))
+
+// Every cascade to every other one, any depth on the empty ones
+#define MAXMULTIMOVES (8 * 7 * KING)
+
+/**
+ * Sorted cards moved from a cascade to another one.
+ */
+typedef struct multimove {
+	uint8_t fromcol;
+	uint8_t tocol;
+	uint8_t card_cnt;
+} MultiMove;
+
+int gen_moves(Board *board, Move *moves);
+int gen_multimoves(Board *board, MultiMove *moves);
+
+#endif
@@ -0,0 +1,331 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "board.h"
+#include "deadlock.h"
+#include "fpset.h"
+#include "freecell.h"
+#include "parallel.h"
+#include "stats.h"
+#include "strategy.h"
+
+// Least slots of the shared visited set, 64MB
+#define PARALLEL_VISITED (1 << 23)
+
+/* Depth-first search of a single deal by many threads. Each worker owns
+ * a board and frames and searches the subtree of a task: the goals from
+ * the root down to a goal whose remaining children are its to search.
+ * The goals above the floor of a worker belong to other workers.
+ *
+ * A worker with nothing left to do registers as hungry, the busy ones
+ * check it at each node and donate their shallowest goal: the
+ * remaining children of its strategies (the goal strat, a and b resume
+ * points) become a task and the floor moves one goal down. The visited
+ * boards are shared and claimed once. The first worker to win cancels
+ * the others, so does the first one to find the visited set full. */
+
+typedef struct task {
+	Frames frames;
+	struct task *next;
+} Task;
+
+/**
+ * State shared by the workers.
+ */
+typedef struct parallel {
+	Board root;
+	FpSet *visited;
+	int threads;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	Task *tasks;
+	int hungry;  // read without the lock by the busy workers
+	int idle;
+	bool done;
+	bool cancel;  // read without the lock by the busy workers
+	bool full;
+
+	// Copy of the solution of the first worker to win
+	Board *board;
+	Frames *frames;
+	bool won;
+} Parallel;
+
+typedef struct worker {
+	Parallel *parallel;
+	int id;
+	Board board;
+	Frames frames;
+	int floor;  // the goals above belong to other workers
+	unsigned long tasks;
+	unsigned long donated;
+	double busy;  // seconds spent searching
+	Stats stats;
+	pthread_t thread;
+} Worker;
+
+static double parallel_clock(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Hand the shallowest goal of the worker to the hungry workers.
+ */
+static void parallel_donate(Parallel *parallel, Worker *worker) {
+	int pending, err;
+	Task *task;
+
+	err = pthread_mutex_lock(&parallel->lock);
+	assert(err == 0);
+	for (pending = 0, task = parallel->tasks; task; task = task->next) pending++;
+	if (parallel->hungry > pending) {
+		task = (Task*)malloc(sizeof(Task));
+		assert(task != NULL);
+		frames_init(&task->frames);
+		frames_split(&task->frames, &worker->frames, worker->floor++);
+		task->next = parallel->tasks;
+		parallel->tasks = task;
+		worker->donated++;
+		err = pthread_cond_signal(&parallel->cond);
+		assert(err == 0);
+	}
+	err = pthread_mutex_unlock(&parallel->lock);
+	assert(err == 0);
+}
+
+/**
+ * Wait for a task, returns NULL once the search is over: a worker won
+ * or every worker ran out of tasks.
+ */
+static Task* parallel_take(Parallel *parallel) {
+	int err;
+	Task *task;
+
+	err = pthread_mutex_lock(&parallel->lock);
+	assert(err == 0);
+	__atomic_add_fetch(&parallel->hungry, 1, __ATOMIC_RELAXED);
+	while (!parallel->tasks && !parallel->done) {
+		if (parallel->idle + 1 == parallel->threads) {
+			parallel->done = true;
+			err = pthread_cond_broadcast(&parallel->cond);
+			assert(err == 0);
+			break;
+		}
+		parallel->idle++;
+		err = pthread_cond_wait(&parallel->cond, &parallel->lock);
+		assert(err == 0);
+		parallel->idle--;
+	}
+	__atomic_sub_fetch(&parallel->hungry, 1, __ATOMIC_RELAXED);
+
+	task = parallel->done ? NULL : parallel->tasks;
+	if (task) parallel->tasks = task->next;
+	err = pthread_mutex_unlock(&parallel->lock);
+	assert(err == 0);
+	return task;
+}
+
+/**
+ * Keep the solution of the first worker to win and stop the others.
+ */
+static void parallel_win(Parallel *parallel, Worker *worker) {
+	int err;
+
+	err = pthread_mutex_lock(&parallel->lock);
+	assert(err == 0);
+	if (!parallel->won) {
+		parallel->won = true;
+		*parallel->board = worker->board;
+		frames_copy(parallel->frames, &worker->frames);
+	}
+	parallel->done = true;
+	__atomic_store_n(&parallel->cancel, true, __ATOMIC_RELAXED);
+	err = pthread_cond_broadcast(&parallel->cond);
+	assert(err == 0);
+	err = pthread_mutex_unlock(&parallel->lock);
+	assert(err == 0);
+}
+
+/**
+ * The depth-first search of search(), resumed from the last goal of the
+ * worker frames (if any) and stopped at its floor.
+ */
+static bool parallel_dfs(Parallel *parallel, Worker *worker) {
+	Board *board = &worker->board;
+	Frames *frames = &worker->frames;
+	Goal *goal;
+
+	compute_properties(board);
+	if (frames->depth) {
+		goal = &frames->goals[frames->depth - 1];
+		goto RECURSION_RETURN;
+	}
+
+	RECURSION:;
+	while (!is_game_won(board)) {
+		if (__atomic_load_n(&parallel->cancel, __ATOMIC_RELAXED)) return false;
+		if (__atomic_load_n(&parallel->hungry, __ATOMIC_RELAXED) && worker->floor + 1 < frames->depth)
+			parallel_donate(parallel, worker);
+
+		// Create a new node on top of the frames
+		goal = frames_push(frames);
+		stats.nodes++;
+
+		// Recompute the various board properties
+		compute_properties(board);
+
+		// Test all strategies on boards no worker claimed
+		if (is_deadlocked(board)) {
+			stats.deadlocks++;
+		} else if (fpset_try_claim(parallel->visited, board->hash)) {
+			stats.visited++;
+			RECURSION_RETURN:;
+			if (strat_next(board, goal) != STRAT_NULL) goto RECURSION;
+		}
+
+		// Out of memory for the visited boards, give up
+		if (fpset_is_full(parallel->visited)) {
+			__atomic_store_n(&parallel->full, true, __ATOMIC_RELAXED);
+			__atomic_store_n(&parallel->cancel, true, __ATOMIC_RELAXED);
+			return false;
+		}
+
+		// Board fully visited, restore the previous node state
+		assert(goal->start == frames->journal.len);
+		frames->depth--;
+
+		// The goals above the floor are searched by other workers
+		if (frames->depth <= worker->floor) return false;
+
+		goal = &frames->goals[frames->depth - 1];
+		journal_undo(&frames->journal, board, goal->start);
+		compute_properties(board);
+		goto RECURSION_RETURN;
+	}
+
+	return true;
+}
+
+static void* parallel_work(void *arg) {
+	int i;
+	double start;
+	Move m;
+	Task *task;
+	Worker *worker = arg;
+	Parallel *parallel = worker->parallel;
+
+	while ((task = parallel_take(parallel))) {
+		start = parallel_clock();
+		worker->tasks++;
+
+		// Replay the moves down to the goal of the task
+		frames_copy(&worker->frames, &task->frames);
+		frames_destroy(&task->frames);
+		free(task);
+		worker->board = parallel->root;
+		for (i = 0; i < worker->frames.journal.len; i++) {
+			m = worker->frames.journal.moves[i];
+			move(&worker->board, (Card*) &worker->board + MOVE_FROM(m), (Card*) &worker->board + MOVE_TO(m));
+		}
+		worker->board.dirty = 0xFF;
+		worker->floor = MAX(0, worker->frames.depth - 1);
+
+		if (parallel_dfs(parallel, worker)) parallel_win(parallel, worker);
+		worker->busy += parallel_clock() - start;
+	}
+
+	worker->stats = stats;
+	return NULL;
+}
+
+/**
+ * Slots of the shared visited set, as many as a quarter of the physical
+ * memory holds.
+ */
+static size_t parallel_capacity(void) {
+	size_t memory, capacity;
+
+	memory = (size_t) sysconf(_SC_PHYS_PAGES) * (size_t) sysconf(_SC_PAGESIZE);
+	for (capacity = PARALLEL_VISITED; capacity * 2 * sizeof(uint64_t) <= memory / 4; capacity <<= 1);
+	return capacity;
+}
+
+/**
+ * Search the board with the given number of worker threads. On success
+ * the board is left won and the frames hold the moves, as search() does.
+ * Sets full when the search stopped on a full visited set.
+ */
+bool parallel_search(Board *board, Frames *frames, int threads, bool *full) {
+	int i, err;
+	double elapsed;
+	Parallel parallel;
+	Worker *workers;
+	Task *root;
+
+	elapsed = parallel_clock();
+	parallel.root = *board;
+	parallel.threads = threads;
+	parallel.board = board;
+	parallel.frames = frames;
+	parallel.hungry = parallel.idle = 0;
+	parallel.done = parallel.cancel = parallel.won = parallel.full = false;
+	fpset_new(&parallel.visited, parallel_capacity());
+	err = pthread_mutex_init(&parallel.lock, NULL);
+	assert(err == 0);
+	err = pthread_cond_init(&parallel.cond, NULL);
+	assert(err == 0);
+
+	root = (Task*)malloc(sizeof(Task));
+	assert(root != NULL);
+	frames_init(&root->frames);
+	root->next = NULL;
+	parallel.tasks = root;
+
+	workers = (Worker*)calloc(threads, sizeof(Worker));
+	assert(workers != NULL);
+	for (i = 0; i < threads; i++) {
+		workers[i].parallel = &parallel;
+		workers[i].id = i;
+		frames_init(&workers[i].frames);
+		err = pthread_create(&workers[i].thread, NULL, parallel_work, &workers[i]);
+		assert(err == 0);
+	}
+
+	for (i = 0; i < threads; i++) {
+		err = pthread_join(workers[i].thread, NULL);
+		assert(err == 0);
+	}
+	elapsed = parallel_clock() - elapsed;
+
+	for (i = 0; i < threads; i++) {
+		printf("Thread %d: %lu nodes, %lu tasks, %lu donated, busy %.0f%%\n",
+				i, workers[i].stats.nodes, workers[i].tasks, workers[i].donated,
+				100 * workers[i].busy / elapsed);
+		stats_add(&stats, &workers[i].stats);
+		frames_destroy(&workers[i].frames);
+	}
+	printf("Threads: %d, search time: %.3fs\n", threads, elapsed);
+	*full = parallel.full && !parallel.won;
+	if (*full) printf("Visited set full after %lu boards.\n", (unsigned long) fpset_size(parallel.visited));
+
+	// Tasks left behind by a win
+	for (; parallel.tasks; parallel.tasks = root) {
+		root = parallel.tasks->next;
+		frames_destroy(&parallel.tasks->frames);
+		free(parallel.tasks);
+	}
+	free(workers);
+	pthread_cond_destroy(&parallel.cond);
+	pthread_mutex_destroy(&parallel.lock);
+	fpset_destroy(parallel.visited);
+	return parallel.won;
+}
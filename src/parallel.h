@@ -0,0 +1,10 @@
+#ifndef FREECELL_PARALLEL_H
+#define FREECELL_PARALLEL_H
+
+#include <stdbool.h>
+#include "board.h"
+#include "freecell.h"
+
+bool parallel_search(Board *board, Frames *frames, int threads, bool *full);
+
+#endif
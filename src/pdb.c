@@ -0,0 +1,203 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "board.h"
+#include "mapping.h"
+#include "pdb.h"
+
+/* Pattern database of a single suit. The board is abstracted to the next
+ * PDB_WINDOW cards of the suit: whether each one is home, parked (on a
+ * freecell) or in a column, at some depth, plus the number of free
+ * slots. The columns are relabelled in the order the cards are met so
+ * the same table serves the four suits. The other cards are anonymous,
+ * they are only the ones stacked on the cards of the window.
+ *
+ * The table holds the moves needed to bring the window home in that
+ * abstract game, where uncovering a card costs a move (two without free
+ * slot as the card must be built somewhere). The other suits are
+ * ignored so the sum over the four suits counts the cards covering the
+ * windows of several suits many times: it is not admissible, it is
+ * meant to guide the best-first engines, not to prove optimality. */
+
+#define PDB_HOME 0
+#define PDB_PARKED 1
+#define PDB_CODE(label, depth) (2 + (label) * PDB_DEPTHS + (depth))
+#define PDB_LABEL(code) (((code) - 2) / PDB_DEPTHS)
+#define PDB_DEPTH(code) (((code) - 2) % PDB_DEPTHS)
+
+#define PDB_MAGIC "FCPDB002"
+#define PDB_INVALID 254
+#define PDB_UNKNOWN 255
+
+static const uint8_t *pdb = NULL;
+
+static uint32_t pdb_index(int *codes, int spaces) {
+	int i;
+	uint32_t index;
+
+	for (index = 0, i = 0; i < PDB_WINDOW; i++)
+		index = index * PDB_CODES + codes[i];
+	return index * PDB_SPACES + spaces;
+}
+
+/**
+ * Remove the top card of the column, the cards of the window under it
+ * get one level higher.
+ */
+static void pdb_uncover(int *codes, int label) {
+	int i;
+
+	for (i = 0; i < PDB_WINDOW; i++) {
+		if (codes[i] < 2 || PDB_LABEL(codes[i]) != label) continue;
+		codes[i]--;
+	}
+}
+
+/**
+ * Fill the table entry of the abstract position and the ones it leads
+ * to, returns its value.
+ */
+static uint8_t pdb_solve(uint8_t *table, uint32_t index) {
+	int i, j, next, last, label, spaces, best, cost, top;
+	int codes[PDB_WINDOW], moved[PDB_WINDOW];
+
+	if (table[index] != PDB_UNKNOWN) return table[index];
+
+	spaces = index % PDB_SPACES;
+	for (j = index / PDB_SPACES, i = PDB_WINDOW - 1; i >= 0; j /= PDB_CODES, i--)
+		codes[i] = j % PDB_CODES;
+
+	// The cards go home in order and two cards cannot share a place, the
+	// trailing cards are home when the window goes past the king
+	for (next = 0; next < PDB_WINDOW && codes[next] == PDB_HOME; next++);
+	for (last = PDB_WINDOW; last > next && codes[last - 1] == PDB_HOME; last--);
+	for (i = next; i < last; i++) {
+		if (codes[i] == PDB_HOME) return table[index] = PDB_INVALID;
+		for (j = i + 1; j < last; j++)
+			if (codes[i] >= 2 && codes[i] == codes[j]) return table[index] = PDB_INVALID;
+	}
+	if (next == PDB_WINDOW) return table[index] = 0;
+
+	best = PDB_INVALID - 1;
+	cost = spaces ? 1 : 2;
+
+	// Send the next card home
+	if (codes[next] == PDB_PARKED || PDB_DEPTH(codes[next]) == 0) {
+		memcpy(moved, codes, sizeof(moved));
+		moved[next] = PDB_HOME;
+		if (codes[next] == PDB_PARKED)
+			best = MIN(best, 1 + pdb_solve(table, pdb_index(moved, MIN(spaces + 1, PDB_SPACES - 1))));
+		else {
+			pdb_uncover(moved, PDB_LABEL(codes[next]));
+			best = MIN(best, 1 + pdb_solve(table, pdb_index(moved, spaces)));
+		}
+	}
+
+	// Uncover a column, parking the card on top
+	for (label = 0; label < PDB_WINDOW; label++) {
+		for (top = -1, i = next; i < PDB_WINDOW; i++) {
+			if (codes[i] < 2 || PDB_LABEL(codes[i]) != label) continue;
+			if (top < 0 || codes[i] < codes[top]) top = i;
+		}
+		if (top < 0 || (top == next && PDB_DEPTH(codes[top]) == 0)) continue;
+
+		memcpy(moved, codes, sizeof(moved));
+		if (PDB_DEPTH(codes[top]) == 0) moved[top] = PDB_PARKED;
+		pdb_uncover(moved, label);
+		best = MIN(best, cost + pdb_solve(table, pdb_index(moved, spaces ? spaces - 1 : 0)));
+	}
+
+	return table[index] = best;
+}
+
+/**
+ * Compute the whole table and save it in a file.
+ */
+void pdb_generate(const char *pathname) {
+	int fd, err;
+	ssize_t written;
+	uint32_t index;
+	uint8_t *table;
+
+	table = (uint8_t*)malloc(PDB_SIZE);
+	assert(table != NULL);
+	memset(table, PDB_UNKNOWN, PDB_SIZE);
+	for (index = 0; index < PDB_SIZE; index++)
+		pdb_solve(table, index);
+
+	fd = open(pathname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	assert(fd > 2);
+	written = write(fd, PDB_MAGIC, 8);
+	assert(written == 8);
+	written = write(fd, table, PDB_SIZE);
+	assert(written == PDB_SIZE);
+	err = close(fd);
+	assert(err == 0);
+	free(table);
+}
+
+/**
+ * Use the table saved by pdb_generate.
+ */
+void pdb_load(const char *pathname) {
+	const void *map;
+	size_t size;
+
+	map = map_file(pathname, &size);
+	assert(size == 8 + PDB_SIZE);
+	assert(memcmp(map, PDB_MAGIC, 8) == 0);
+	pdb = (const uint8_t*) map + 8;
+}
+
+bool pdb_loaded(void) {
+	return pdb != NULL;
+}
+
+/**
+ * Sum of the table values of the four suits, plus a move for each card
+ * not in a window and not home.
+ */
+int pdb_lookup(Board *board) {
+	int suit, i, j, k, col, spaces, h;
+	int codes[PDB_WINDOW], base[PDB_WINDOW], depths[PDB_WINDOW], labels[8];
+	Card card, *slot;
+	CardPosPair cpp;
+
+	spaces = MIN(count_freecell(board) + count_empty_column(board), PDB_SPACES - 1);
+	h = 0;
+	for (suit = 0; suit < 4; suit++) {
+		for (col = 0; col < 8; col++) labels[col] = -1;
+		for (k = 0, i = 0; i < PDB_WINDOW; i++) {
+			codes[i] = PDB_HOME;
+			if (board->fdlen[suit] + i > KING) continue;
+			card = CARD(suit, board->fdlen[suit] + i);
+			slot = locate_card(board, card);
+			if (slot < (Card*) board->foundation) {
+				codes[i] = PDB_PARKED;
+				continue;
+			}
+			cpp = search_card(board, card);
+			if (labels[cpp.col] < 0) labels[cpp.col] = k++;
+			codes[i] = PDB_CODE(labels[cpp.col], 0);
+			depths[i] = board->cslen[cpp.col] - 1 - cpp.row;
+		}
+
+		// Cap the depths keeping the cards of a column apart
+		memcpy(base, codes, sizeof(base));
+		for (i = 0; i < PDB_WINDOW; i++) {
+			if (base[i] < 2) continue;
+			for (k = 0, j = 0; j < PDB_WINDOW; j++)
+				if (base[j] == base[i] && depths[j] > depths[i]) k++;
+			codes[i] += MIN(depths[i], PDB_DEPTHS - 1 - k);
+		}
+
+		h += pdb[pdb_index(codes, spaces)];
+		h += MAX(0, KING + 1 - board->fdlen[suit] - PDB_WINDOW);
+	}
+
+	return h;
+}
@@ -0,0 +1,26 @@
+#ifndef FREECELL_PDB_H
+#define FREECELL_PDB_H
+
+#include <stdbool.h>
+#include "board.h"
+
+// The next cards of a suit taken into account
+#define PDB_WINDOW 4
+
+// Depth of a card in its column, the deeper ones are capped
+#define PDB_DEPTHS 8
+
+// Home, parked or in one of PDB_WINDOW columns at one of PDB_DEPTHS depths
+#define PDB_CODES (2 + PDB_WINDOW * PDB_DEPTHS)
+
+// 0 to 4 free slots (freecells and empty columns)
+#define PDB_SPACES 5
+
+#define PDB_SIZE (PDB_CODES * PDB_CODES * PDB_CODES * PDB_CODES * PDB_SPACES)
+
+void pdb_generate(const char *pathname);
+void pdb_load(const char *pathname);
+bool pdb_loaded(void);
+int pdb_lookup(Board *board);
+
+#endif
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include "stats.h"
+
+__thread Stats stats;
+
+/**
+ * Add the counters of a thread to the total.
+ */
+void stats_add(Stats *total, Stats *part) {
+	total->nodes += part->nodes;
+	total->visited += part->visited;
+	total->columns += part->columns;
+	total->columns_saved += part->columns_saved;
+	total->deadlocks += part->deadlocks;
+	total->autoplayed += part->autoplayed;
+	total->states += part->states;
+	total->reexpanded += part->reexpanded;
+}
+
+/**
+ * Print the search counters on screen.
+ */
+void stats_show(void) {
+	printf("Nodes: %lu, visited boards: %lu\n", stats.nodes, stats.visited);
+	printf("Columns recomputed: %lu, saved: %lu\n", stats.columns, stats.columns_saved);
+	printf("Autoplayed moves: %lu, deadlocks: %lu\n", stats.autoplayed, stats.deadlocks);
+	if (stats.states)
+		printf("Stored states: %lu\n", stats.states);
+	if (stats.reexpanded)
+		printf("Re-expansions: %lu\n", stats.reexpanded);
+}
@@ -0,0 +1,24 @@
+#ifndef FREECELL_STATS_H
+#define FREECELL_STATS_H
+
+/**
+ * Counters collected during the search, shown once it is over. Each
+ * thread has its own.
+ */
+typedef struct stats {
+	unsigned long nodes;  // search nodes created
+	unsigned long visited;  // distinct boards explored
+	unsigned long columns;  // column properties recomputed
+	unsigned long columns_saved;  // clean columns not recomputed
+	unsigned long deadlocks;  // lost boards pruned
+	unsigned long autoplayed;  // safe moves folded in the previous node
+	unsigned long states;  // boards stored by the best-first engines
+	unsigned long reexpanded;  // boards expanded again by a later iteration
+} Stats;
+
+extern __thread Stats stats;
+
+void stats_add(Stats *total, Stats *part);
+void stats_show(void);
+
+#endif
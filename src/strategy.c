@@ -1,9 +1,11 @@
 #include <stdbool.h>
 #include <assert.h>
 #include "board.h"
-#include "stack.h"
+#include "endgame.h"
+#include "movegen.h"
 #include "strategy.h"
 #include "isort.h"
+#include "stats.h"
 
 /**
  * The "Rule of Two" is a freecell property that indicates a card can be
@@ -32,19 +34,36 @@
  * value + 1" card.
  */
 bool respect_rule_of_two(Board *board, Card fromcard) {
-	return fromcard.rank <= MIN(
-		board->fdlen[(1 - fromcard.color) * 2 + 0],
-		board->fdlen[(1 - fromcard.color) * 2 + 1]
+	return RANK(fromcard) <= MIN(
+		board->fdlen[(1 - COLOR(fromcard)) * 2 + 0],
+		board->fdlen[(1 - COLOR(fromcard)) * 2 + 1]
 	) + 1;  // +2 but there is a nullcard on top
 }
 
+/**
+ * Whether the card can go to the foundation without ever being needed
+ * back: no opposite colour card could be built on it (rank up to the
+ * least opposite foundation + 1), or, following Horne, up to + 2 when
+ * the other suit of its colour is home up to rank - 3.
+ */
+bool is_safe_home(Board *board, Card fromcard) {
+	int opposite;
+
+	opposite = MIN(
+		board->fdlen[(1 - COLOR(fromcard)) * 2 + 0],
+		board->fdlen[(1 - COLOR(fromcard)) * 2 + 1]
+	);  // ranks are one higher than the tops as there is a nullcard
+	if (RANK(fromcard) <= opposite) return true;
+	return RANK(fromcard) <= opposite + 1 && board->fdlen[SUIT(fromcard) ^ 1] >= RANK(fromcard) - 2;
+}
+
 
 int comp_buildfactor(const void *p1, const void *p2, const void *arg) {
 	int col1, col2;
 	Board *board;
 
-	col1 = *((int*)p1);
-	col2 = *((int*)p2);
+	col1 = *((int8_t*)p1);
+	col2 = *((int8_t*)p2);
 	board = (Board*) arg;
 
 	if (board->buildfactor[col1] > board->buildfactor[col2])
@@ -60,10 +79,10 @@ int comp_highest_sorted_card(const void *p1, const void *p2, const void *arg) {
 	Board *board;
 
 	board = (Board*) arg;
-	col1 = *((int*)p1);
-	col2 = *((int*)p2);
-	card_value1 = col1 >= 0 ? highest_sorted_card(board, col1)->rank : board->freecell[col1 + 4].rank;
-	card_value2 = col2 >= 0 ? highest_sorted_card(board, col2)->rank : board->freecell[col2 + 4].rank;
+	col1 = *((int8_t*)p1);
+	col2 = *((int8_t*)p2);
+	card_value1 = RANK(col1 >= 0 ? *highest_sorted_card(board, col1) : board->freecell[col1 + 4]);
+	card_value2 = RANK(col2 >= 0 ? *highest_sorted_card(board, col2) : board->freecell[col2 + 4]);
 
 	if (card_value1 > card_value2)
 		return 1;
@@ -77,8 +96,8 @@ int comp_fdlen(const void *p1, const void *p2, const void *arg) {
 	int suit1, suit2;
 	Board *board;
 
-	suit1 = *((int*)p1);
-	suit2 = *((int*)p2);
+	suit1 = *((int8_t*)p1);
+	suit2 = *((int8_t*)p2);
 	board = (Board*) arg;
 
 	if (board->fdlen[suit1] > board->fdlen[suit2])
@@ -92,8 +111,8 @@ int comp_collen(const void *p1, const void *p2, const void *arg) {
 	int col1, col2;
 	Board *board;
 
-	col1 = *((int*)p1);
-	col2 = *((int*)p2);
+	col1 = *((int8_t*)p1);
+	col2 = *((int8_t*)p2);
 	board = (Board*) arg;
 
 	if (board->cslen[col1] > board->cslen[col2])
@@ -104,6 +123,86 @@ int comp_collen(const void *p1, const void *p2, const void *arg) {
 }
 
 
+/**
+ * Move the cards safe to home to the foundation until there is none left,
+ * returns how many were moved. The looser rule of two is left to
+ * strat_rule_of_two so the search can take it back.
+ */
+int autoplay(Board *board, Journal *journal) {
+	int col, suit, moves_cnt, len;
+	Card *fromcard;
+
+	moves_cnt = 0;
+	do {
+		len = moves_cnt;
+		for (col = -4; col < 8; col++) {  // freecells are -4->-1
+			fromcard = col < 0 ? &board->freecell[col + 4] : bottom_card(board, col);
+			if (is_nullcard(*fromcard)) continue;
+			if (!can_home(board, *fromcard) || !is_safe_home(board, *fromcard)) continue;
+			suit = SUIT(*fromcard);
+			journal_move(journal, board, fromcard, &board->foundation[suit][board->fdlen[suit]]);
+			moves_cnt++;
+		}
+	} while (moves_cnt > len);
+
+	return moves_cnt;
+}
+
+/**
+ * Once every cascade is sorted, the lowest card left is always at the
+ * bottom of a cascade or on a freecell and can go to the foundation.
+ * Move them all, the game is won.
+ */
+void strat_auto_win(Board *board, Goal *goal) {
+	int col, suit, len;
+	Card *fromcard;
+
+	if (board->unsorted || goal->a) return;
+
+	while (!is_game_won(board)) {
+		len = goal->journal->len;
+		for (col = -4; col < 8; col++) {  // freecells are -4->-1
+			fromcard = col < 0 ? &board->freecell[col + 4] : bottom_card(board, col);
+			if (is_nullcard(*fromcard) || !can_home(board, *fromcard)) continue;
+			suit = SUIT(*fromcard);
+			journal_move(goal->journal, board, fromcard, &board->foundation[suit][board->fdlen[suit]]);
+		}
+		assert(goal->journal->len > len);
+	}
+
+	goal->strat = STRAT_AUTO_WIN;
+	goal->a = 1;
+}
+
+/**
+ * Once few enough cards are left in play, follow the endgame table
+ * down to the won board.
+ */
+void strat_endgame(Board *board, Goal *goal) {
+	int i, len, dist;
+	Move moves[MAXMOVES];
+	Card *fromcard, *tocard;
+
+	if (goal->a || !endgame_loaded()) return;
+	dist = endgame_lookup(board);
+	if (dist < 0) return;
+
+	for (; dist; dist--) {
+		len = gen_moves(board, moves);
+		for (i = 0; i < len; i++) {
+			fromcard = (Card*) board + MOVE_FROM(moves[i]);
+			tocard = (Card*) board + MOVE_TO(moves[i]);
+			journal_move(goal->journal, board, fromcard, tocard);
+			if (endgame_lookup(board) == dist - 1) break;
+			journal_undo(goal->journal, board, goal->journal->len - 1);
+		}
+		assert(i < len);
+	}
+
+	goal->strat = STRAT_ENDGAME;
+	goal->a = 1;
+}
+
 /**
  * It is always possible to move the cards with the least value in the
  * cascades and freecells to the foundation.
@@ -112,32 +211,32 @@ void strat_rule_of_two(Board *board, Goal *goal) {
 	int fromcol, symbol;
 	Card *fromcard, *tocard;
 
+	// There is a single way to play the rule
+	if (goal->a) return;
+
 	// From freecell to foundation
 	for (fromcol = 0; fromcol < 4; fromcol++) {
 		fromcard = &(board->freecell[fromcol]);
-		symbol = fromcard->color * 2 + fromcard->suit;
+		symbol = SUIT(*fromcard);
 		tocard = &(board->foundation[symbol][board->fdlen[symbol] - 1]);
-		if (is_move_valid(*fromcard, *tocard, 'h') && respect_rule_of_two(board, *fromcard)) {
-			assert(stack_push(goal->nextmoves, fromcard) == CC_OK);
-			assert(stack_push(goal->nextmoves, tocard + 1) == CC_OK);
-			move(board, fromcard, tocard + 1);
+		if (can_home(board, *fromcard) && respect_rule_of_two(board, *fromcard)) {
+			journal_move(goal->journal, board, fromcard, tocard + 1);
 		}
 	}
 
 	// From column to foundation
 	for (fromcol = 0; fromcol < 8; fromcol++) {
 		fromcard = bottom_card(board, fromcol);
-		symbol = fromcard->color * 2 + fromcard->suit;
+		symbol = SUIT(*fromcard);
 		tocard = &(board->foundation[symbol][board->fdlen[symbol] - 1]);
-		if (is_move_valid(*fromcard, *tocard, 'h') && respect_rule_of_two(board, *fromcard)) {
-			assert(stack_push(goal->nextmoves, fromcard) == CC_OK);
-			assert(stack_push(goal->nextmoves, tocard + 1) == CC_OK);
-			move(board, fromcard, tocard + 1);
+		if (can_home(board, *fromcard) && respect_rule_of_two(board, *fromcard)) {
+			journal_move(goal->journal, board, fromcard, tocard + 1);
 		}
 	}
 
-	if (stack_size(goal->nextmoves)) {
+	if (goal->journal->len > goal->start) {
 		goal->strat = STRAT_RULE_OF_TWO;
+		goal->a = 1;
 	}
 }
 
@@ -149,22 +248,24 @@ void strat_rule_of_two(Board *board, Goal *goal) {
 void strat_build_down(Board *board, Goal *goal) {
 	int i, j, tocol, fromcol, depth;
 	Card *tocard, *fromcard;
-	int columns[] = {0, 1, 2, 3, 4, 5, 6, 7};
 
-	isort_r(columns, 8, sizeof(int), comp_buildfactor, board);
+	// Columns sorted by build factor
+	if (goal->ncand < 0) {
+		for (i = 0; i < 8; i++) goal->cand[i] = i;
+		isort_r(goal->cand, 8, sizeof(int8_t), comp_buildfactor, board);
+		goal->ncand = 8;
+	}
 
 	for (i = goal->a; i >= 0; i--) {  // i = 7, highest build factor
-		tocol = columns[i];
+		tocol = goal->cand[i];
 		if (is_empty(board, tocol)) continue;
 		tocard = bottom_card(board, tocol);
 
 		// From freecell to column
 		for (fromcol = goal->b; fromcol < 0; fromcol++) {  // fromcol = -4
 			fromcard = &(board->freecell[fromcol + 4]);
-			if (is_move_valid(*fromcard, *tocard, 'c')) {
-				assert(stack_push(goal->nextmoves, fromcard) == CC_OK);
-				assert(stack_push(goal->nextmoves, tocard + 1) == CC_OK);
-				move(board, fromcard, tocard + 1);
+			if (can_build(*fromcard, *tocard)) {
+				journal_move(goal->journal, board, fromcard, tocard + 1);
 				goal->strat = STRAT_BUILD_DOWN;
 				goal->a = i;
 				goal->b = fromcol + 1;
@@ -174,13 +275,13 @@ void strat_build_down(Board *board, Goal *goal) {
 
 		// From column to column
 		for (j = MAX(0, goal->b); j < i; j++) {  // j = 0, lowest build factor
-			fromcol = columns[j];
+			fromcol = goal->cand[j];
 			if (is_empty(board, fromcol)) continue;
 
 			depth = supermove_depth(board, fromcol, tocol);
 			if (!depth) continue;
 
-			if (supermove(board, fromcol, tocol, depth, goal->nextmoves)) {
+			if (supermove(board, fromcol, tocol, depth, goal->journal)) {
 				goal->strat = STRAT_BUILD_DOWN;
 				goal->a = i;
 				goal->b = j + 1;
@@ -195,43 +296,44 @@ void strat_build_down(Board *board, Goal *goal) {
  * partially-sorted columns when it is impossible to move all the sorted cards.
  */
 void strat_build_empty(Board *board, Goal *goal) {
-	int fromcol, tocol, columns_length, i;
-	int columns[12];  // Maximum 8 columns + 4 freecells, columns are indexed 0->7, freecells are indexed -4->-1
-
-	// Find an empty column
-	for (tocol = 0; tocol < 8 && !is_empty(board, tocol); tocol++);
-	if (tocol == 8) return;
-
-	// Complete columns[] with non-empty, non-fully-sorted column indexes
-	// sort it by highest sorted card
-	columns_length = 0;
-	for (fromcol = -4; fromcol < 0; fromcol++) {  // hack, freecell indexes are negatives
-		if (is_nullcard(board->freecell[fromcol + 4])) continue;
-		columns[columns_length++] = fromcol;
-	}
-	for (; fromcol < 8; fromcol++) {
-		if (is_empty(board, fromcol)) continue;
-		if (is_fully_sorted(board, fromcol)) continue;
-		columns[columns_length++] = fromcol;
+	int fromcol, tocol, i;
+
+	// Find an empty column (kept in goal->b), complete the candidates
+	// with non-empty, non-fully-sorted column indexes (maximum 8 columns
+	// + 4 freecells, columns are indexed 0->7, freecells are indexed
+	// -4->-1) sort them by highest sorted card
+	if (goal->ncand < 0) {
+		goal->ncand = 0;
+		for (tocol = 0; tocol < 8 && !is_empty(board, tocol); tocol++);
+		if (tocol == 8) return;
+		goal->b = tocol;
+
+		for (fromcol = -4; fromcol < 0; fromcol++) {  // hack, freecell indexes are negatives
+			if (is_nullcard(board->freecell[fromcol + 4])) continue;
+			goal->cand[goal->ncand++] = fromcol;
+		}
+		for (; fromcol < 8; fromcol++) {
+			if (is_empty(board, fromcol)) continue;
+			if (is_fully_sorted(board, fromcol)) continue;
+			goal->cand[goal->ncand++] = fromcol;
+		}
+		isort_r(goal->cand, goal->ncand, sizeof(int8_t), comp_highest_sorted_card, board);
 	}
-	if (!columns_length) return;
-	isort_r(columns, columns_length, sizeof(int), comp_highest_sorted_card, board);
+	tocol = goal->b;
 
-	for (i = MIN(goal->a, columns_length - 1); i >= 0; i--) {  // i = 11
-		fromcol = columns[i];
+	for (i = MIN(goal->a, goal->ncand - 1); i >= 0; i--) {  // i = 11
+		fromcol = goal->cand[i];
 
 		// From freecell to empty column
 		if (fromcol < 0) {
-			stack_push(goal->nextmoves, &board->freecell[fromcol + 4]);
-			stack_push(goal->nextmoves, bottom_card(board, tocol) + 1);
-			move(board, &board->freecell[fromcol + 4], bottom_card(board, tocol) + 1);
+			journal_move(goal->journal, board, &board->freecell[fromcol + 4], bottom_card(board, tocol) + 1);
 			goal->strat = STRAT_BUILD_EMPTY;
 			goal->a = i - 1;
 			return;
 		}
 
 		// From column to empty column (only full move)
-		if (supermove(board, fromcol, tocol, board->sortdepth[fromcol], goal->nextmoves)) {
+		if (supermove(board, fromcol, tocol, board->sortdepth[fromcol], goal->journal)) {
 			goal->strat = STRAT_BUILD_EMPTY;
 			goal->a = i - 1;
 			return;
@@ -245,40 +347,37 @@ void strat_build_empty(Board *board, Goal *goal) {
  */
 void strat_access_low_card(Board *board, Goal *goal) {
 	int i, symbol;
-	int symbols[4] = {0, 1, 2, 3};
-	Card low_card, *card;
+	Card low_card;
 	CardPosPair cpp;
 
-	isort_r(symbols, 4, sizeof(int), comp_fdlen, board);
+	// Suits sorted by foundation length
+	if (goal->ncand < 0) {
+		for (i = 0; i < 4; i++) goal->cand[i] = i;
+		isort_r(goal->cand, 4, sizeof(int8_t), comp_fdlen, board);
+		goal->ncand = 4;
+	}
 
 	for (i = goal->a; i < 4; i++) {  // i = 0
-		symbol = symbols[i];
-		low_card.color = (symbol & 0b10) > 1;
-		low_card.suit = symbol & 0b01;
-		low_card.rank = board->fdlen[symbol];
-
-		if (low_card.rank == KING + 1)
+		symbol = goal->cand[i];
+		if (board->fdlen[symbol] == KING + 1)
 			continue;
 
+		low_card = CARD(symbol, board->fdlen[symbol]);
 		cpp = search_card(board, low_card);
 
 		// Low card found on freecell, from freecell to foundation
 		if (cpp.row == MAXCSLEN) {  // Awful hack
-			stack_push(goal->nextmoves, &board->freecell[cpp.col]);
-			stack_push(goal->nextmoves, &board->foundation[symbol][board->fdlen[symbol]]);
-			move(board, &board->freecell[cpp.col], &board->foundation[symbol][board->fdlen[symbol]]);
+			journal_move(goal->journal, board, &board->freecell[cpp.col], &board->foundation[symbol][board->fdlen[symbol]]);
 			goal->strat = STRAT_ACCESS_LOW_CARD;
 			goal->a = i + 1;
 			return;
 		}
 
 		// Spread cards around until ours is accessible
-		if (!superaccess(board, cpp, goal->nextmoves, true)) continue;
+		if (!superaccess(board, cpp, goal->journal, true)) continue;
 
 		// Low card found at bottom of column, from column to foundation
-		stack_push(goal->nextmoves, bottom_card(board, cpp.col));
-		stack_push(goal->nextmoves, &board->foundation[symbol][board->fdlen[symbol]]);
-		move(board, bottom_card(board, cpp.col), &board->foundation[symbol][board->fdlen[symbol]]);
+		journal_move(goal->journal, board, bottom_card(board, cpp.col), &board->foundation[symbol][board->fdlen[symbol]]);
 		goal->strat = STRAT_ACCESS_LOW_CARD;
 		goal->a = i + 1;
 		return;
@@ -286,33 +385,31 @@ void strat_access_low_card(Board *board, Goal *goal) {
 }
 
 void strat_access_build_card(Board *board, Goal *goal) {
-	int i, s, suit, tocol, columns_length;
+	int i, s, suit, tocol;
 	CardPosPair cpp;
 	Card *tocard, build_card;
-	int columns[8];
 
 	// Make a list sorted by build-factor of non-empty fully sorted columns
-	columns_length = 0;
-	for (tocol = goal->a; tocol < 8; tocol++) {
-		if (is_empty(board, tocol)) continue;
-		if (!is_fully_sorted(board, tocol)) continue;
-		columns[columns_length++] = tocol;
+	if (goal->ncand < 0) {
+		goal->ncand = 0;
+		for (tocol = 0; tocol < 8; tocol++) {
+			if (is_empty(board, tocol)) continue;
+			if (!is_fully_sorted(board, tocol)) continue;
+			goal->cand[goal->ncand++] = tocol;
+		}
+		isort_r(goal->cand, goal->ncand, sizeof(int8_t), comp_buildfactor, board);
 	}
-	if (!columns_length) return;
-	isort_r(columns, columns_length, sizeof(int), comp_buildfactor, board);
 
 	// For each column...
-	for (i = MIN(goal->a, columns_length - 1); i >= 0; i--) {  // i = 7
-		tocol = columns[i];
+	for (i = MIN(goal->a, goal->ncand - 1); i >= 0; i--) {  // i = 7
+		tocol = goal->cand[i];
 		tocard = bottom_card(board, tocol);
 
 		// ...search for a card that can be moved at the bottom
-		build_card.rank = tocard->rank - 1;
-		build_card.color = 1 - tocard->color;
 		for (s = goal->b; s < 2; s++) {  // // s = 0
-			build_card.suit = s;
-			suit = build_card.color * 2 + build_card.suit;
-			if (build_card.rank <= board->fdlen[suit]) continue;  // card is on the foundation already
+			suit = (1 - COLOR(*tocard)) * 2 + s;
+			if (RANK(*tocard) - 1 <= board->fdlen[suit]) continue;  // card is on the foundation already
+			build_card = CARD(suit, RANK(*tocard) - 1);
 			cpp = search_card(board, build_card);
 
 			// If the card is movable right away then STRAT_BUILD_DOWN already did search it
@@ -320,7 +417,7 @@ void strat_access_build_card(Board *board, Goal *goal) {
 			if (cpp.row >= board->cslen[cpp.col] - board->sortdepth[cpp.col]) continue;
 
 			// Spread cards around until ours is accessible
-			if (!superaccess(board, cpp, goal->nextmoves, true)) continue;
+			if (!superaccess(board, cpp, goal->journal, true)) continue;
 
 			// There is a chance the card of the other symbol (same color)
 			// was under the build_card, in such case there is a change it
@@ -328,9 +425,7 @@ void strat_access_build_card(Board *board, Goal *goal) {
 			// conditional is false but the strategy is still validated
 			if (bottom_card(board, tocol) == tocard) {
 				// Build using the now accessible card
-				stack_push(goal->nextmoves, bottom_card(board, cpp.col));
-				stack_push(goal->nextmoves, tocard + 1);
-				move(board, bottom_card(board, cpp.col), tocard + 1);
+				journal_move(goal->journal, board, bottom_card(board, cpp.col), tocard + 1);
 			}
 			goal->strat = STRAT_ACCESS_BUILD_CARD;
 			goal->a = i;
@@ -342,17 +437,21 @@ void strat_access_build_card(Board *board, Goal *goal) {
 
 void strat_access_empty(Board *board, Goal *goal) {
 	int i;
-	int columns[] = {0, 1, 2, 3, 4, 5, 6, 7};
 	CardPosPair cpp;
 
-	isort_r(columns, 8, sizeof(int), comp_collen, board);
+	// Columns sorted by length
+	if (goal->ncand < 0) {
+		for (i = 0; i < 8; i++) goal->cand[i] = i;
+		isort_r(goal->cand, 8, sizeof(int8_t), comp_collen, board);
+		goal->ncand = 8;
+	}
 
 	for (i = goal->a; i >= 0; i--) {  // i = 7
 		cpp.row = 0;
-		cpp.col = columns[i];
+		cpp.col = goal->cand[i];
 
 		if (is_fully_sorted(board, cpp.col) && board->cslen[cpp.col] > 4) continue;
-		if (!superaccess(board, cpp, goal->nextmoves, false)) continue;
+		if (!superaccess(board, cpp, goal->journal, false)) continue;
 
 		goal->strat = STRAT_ACCESS_EMPTY;
 		goal->a = i - 1;
@@ -361,21 +460,23 @@ void strat_access_empty(Board *board, Goal *goal) {
 
 
 void strat_any_move_cascade(Board *board, Goal *goal) {
-	int fromcol, tocol, depth;
+	int fromcol, tocol, depth, empty;
 	Card *fromcard, *tocard;
 
+	// The empty cascades are all the same, only the first one is tried
+	for (empty = 0; empty < 8 && !is_empty(board, empty); empty++);
+
 	// To cascade...
 	for (tocol = goal->a; tocol < 8; tocol++) {  // tocol = 0;
+		if (tocol > empty && is_empty(board, tocol)) continue;
 		tocard = bottom_card(board, tocol);
 
 		// ... from freecell
 		fromcol = goal->b;
 		for (; fromcol < 0; fromcol++) {  // fromcol = -4;
 			fromcard = &board->freecell[fromcol + 4];
-			if (!is_move_valid(*fromcard, *tocard, 'c')) continue;
-			assert(stack_push(goal->nextmoves, fromcard) == CC_OK);
-			assert(stack_push(goal->nextmoves, tocard + 1) == CC_OK);
-			move(board, fromcard, tocard + 1);
+			if (!can_build(*fromcard, *tocard)) continue;
+			journal_move(goal->journal, board, fromcard, tocard + 1);
 			goal->strat = STRAT_ANY_MOVE_CASCADE;
 			goal->a = tocol;
 			goal->b = fromcol + 1;
@@ -390,7 +491,7 @@ void strat_any_move_cascade(Board *board, Goal *goal) {
 			depth = supermove_depth(board, fromcol, tocol);
 			if (!depth) continue;
 
-			if (!supermove(board, fromcol, tocol, depth, goal->nextmoves)) continue;
+			if (!supermove(board, fromcol, tocol, depth, goal->journal)) continue;
 			goal->strat = STRAT_ANY_MOVE_CASCADE;
 			goal->a = tocol;
 			goal->b = fromcol + 1;
@@ -405,13 +506,11 @@ void strat_any_move_foundation(Board *board, Goal *goal) {
 
 	for (fromcol = goal->a; fromcol < 8; fromcol++) {  // fromcol = 0
 		fromcard = fromcol < 0 ? &board->freecell[fromcol + 4] : bottom_card(board, fromcol);
-		suit = fromcard->color * 2 + fromcard->suit;
+		suit = SUIT(*fromcard);
 		tocard = &board->foundation[suit][board->fdlen[suit] - 1];
-		if (!is_move_valid(*fromcard, *tocard, 'h')) continue;
+		if (!can_home(board, *fromcard)) continue;
 
-		assert(stack_push(goal->nextmoves, fromcard) == CC_OK);
-		assert(stack_push(goal->nextmoves, tocard + 1) == CC_OK);
-		move(board, fromcard, tocard + 1);
+		journal_move(goal->journal, board, fromcard, tocard + 1);
 		goal->strat = STRAT_ANY_MOVE_FOUNDATION;
 		goal->a = fromcol + 1;
 		return;
@@ -419,18 +518,20 @@ void strat_any_move_foundation(Board *board, Goal *goal) {
 }
 
 void strat_any_move_freecell(Board *board, Goal *goal) {
-	int freecell_cnt, fromcol, i, depth;
-	Card *freecells[12];
+	int freecell_cnt, fromcol, tocol, i, depth;
 	Card *fromcard, *tocard;
 
-	// Stack freecells and empty columns (freecells on top)
-	freecell_cnt=0;
-	for (fromcol = 0; fromcol < 8; fromcol++)
-		if (is_empty(board, fromcol))
-			freecells[freecell_cnt++] = &board->cascade[fromcol][1];
-	for (fromcol = 0; fromcol < 4; fromcol++)
-		if (is_nullcard(board->freecell[fromcol]))
-			freecells[freecell_cnt++] = &board->freecell[fromcol];
+	// Stack empty columns and freecells (freecells on top, indexed -4->-1)
+	if (goal->ncand < 0) {
+		goal->ncand = 0;
+		for (tocol = 0; tocol < 8; tocol++)
+			if (is_empty(board, tocol))
+				goal->cand[goal->ncand++] = tocol;
+		for (tocol = 0; tocol < 4; tocol++)
+			if (is_nullcard(board->freecell[tocol]))
+				goal->cand[goal->ncand++] = tocol - 4;
+	}
+	freecell_cnt = goal->ncand;
 	if (!freecell_cnt) return;
 
 	// Find a column from which we can move all sorted cards to freecells
@@ -440,13 +541,85 @@ void strat_any_move_freecell(Board *board, Goal *goal) {
 		if (depth > freecell_cnt) continue;
 
 		for (fromcard = bottom_card(board, fromcol), i = 0; i < depth; fromcard--, i++) {
-			tocard = freecells[--freecell_cnt];
-			assert(stack_push(goal->nextmoves, fromcard) == CC_OK);
-			assert(stack_push(goal->nextmoves, tocard) == CC_OK);
-			move(board, fromcard, tocard);
+			tocol = goal->cand[--freecell_cnt];
+			tocard = tocol < 0 ? &board->freecell[tocol + 4] : &board->cascade[tocol][1];
+			journal_move(goal->journal, board, fromcard, tocard);
 		}
 		goal->strat = STRAT_ANY_MOVE_FREECELL;
 		goal->a = fromcol + 1;
 		return;
 	}
 }
+
+
+/* There are many strategy sorted in this array by preference, each
+ * index also map to the internal value of the "strat" enum. */
+static void (*strategies[])(Board *, Goal *) = {
+		NULL,
+		strat_auto_win,
+		strat_endgame,
+		strat_rule_of_two,
+		strat_build_down,
+		strat_build_empty,
+		strat_access_low_card,
+		strat_access_build_card,
+		strat_access_empty,
+		strat_any_move_cascade,
+		strat_any_move_foundation,
+		strat_any_move_freecell,
+};
+
+/* Each strategy uses special "initializers" so it is possible to
+ * fast-forward their internal loop when we backtrack. This array
+ * contains the starting values, e.g. "0" in "for (i = 0; i < 10; i++)" */
+static int goal_inits[12][2] = {
+		{0, 0},  // STRAT_NULL
+		{0, 0},  // STRAT_AUTO_WIN
+		{0, 0},  // STRAT_ENDGAME
+		{0, 0},  // STRAT_RULE_OF_TWO
+		{7, -4},  // STRAT_BUILD_DOWN
+		{11, 0},  // STRAT_BUILD_EMPTY
+		{0, 0},  // STRAT_ACCESS_LOW_CARD
+		{7, 0},  // STRAT_ACCESS_BUILD_CARD
+		{7, 0},  // STRAT_ACCESS_EMPTY
+		{0, -4},  // STRAT_ANY_MOVE_CASCADE
+		{0, 0},  // STRAT_ANY_MOVE_FOUNDATION
+		{0, 0},  // STRAT_ANY_MOVE_FREECELL
+};
+
+/**
+ * Rewind the goal cursors to the start of the strategy.
+ */
+void strat_init(Goal *goal, enum strat strat) {
+	goal->a = goal_inits[strat][0];
+	goal->b = goal_inits[strat][1];
+	goal->ncand = -1;
+}
+
+/**
+ * Play the next child of the goal followed by the safe foundation moves
+ * it unlocked, the moves are appended to the journal and the matching
+ * strategy is returned, STRAT_NULL once all
+ * the strategies are exhausted. The goal strategy must be STRAT_NULL
+ * on the first call, the moves of the child must be undone before
+ * calling again.
+ */
+enum strat strat_next(Board *board, Goal *goal) {
+	enum strat strat;
+
+	// Resume the strategy of the previous child or start over
+	strat = goal->strat;
+	goal->strat = STRAT_NULL;
+	if (strat == STRAT_NULL) strat_init(goal, strat = STRAT_AUTO_WIN);
+
+	for (;;) {
+		strategies[strat](board, goal);
+		if (goal->strat != STRAT_NULL) {
+			// The safe moves are part of the child, not a new one
+			stats.autoplayed += autoplay(board, goal->journal);
+			return goal->strat;
+		}
+		if (strat == STRAT_ANY_MOVE_FREECELL) return STRAT_NULL;
+		strat_init(goal, ++strat);
+	}
+}
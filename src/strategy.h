@@ -1,34 +1,49 @@
 #ifndef FREECELL_STRATEGY_H
 #define FREECELL_STRATEGY_H
 
-#include "stack.h"
+#include "board.h"
 
 enum strat {
 	STRAT_NULL = 0,   // When we are still searching
-	STRAT_RULE_OF_TWO = 1,
-	STRAT_BUILD_DOWN = 2,
-	STRAT_BUILD_EMPTY = 3,
-	STRAT_ACCESS_LOW_CARD = 4,
-	STRAT_ACCESS_BUILD_CARD = 5,
-	STRAT_ACCESS_EMPTY = 6,
-	STRAT_ANY_MOVE_CASCADE = 7,
-	STRAT_ANY_MOVE_FOUNDATION = 8,
-	STRAT_ANY_MOVE_FREECELL = 9,  // Last resort
+	STRAT_AUTO_WIN = 1,
+	STRAT_ENDGAME = 2,
+	STRAT_RULE_OF_TWO = 3,
+	STRAT_BUILD_DOWN = 4,
+	STRAT_BUILD_EMPTY = 5,
+	STRAT_ACCESS_LOW_CARD = 6,
+	STRAT_ACCESS_BUILD_CARD = 7,
+	STRAT_ACCESS_EMPTY = 8,
+	STRAT_ANY_MOVE_CASCADE = 9,
+	STRAT_ANY_MOVE_FOUNDATION = 10,
+	STRAT_ANY_MOVE_FREECELL = 11,  // Last resort
 };
 
 typedef struct goal {
-	Stack * nextmoves;
+	Journal *journal;  // shared by all goals
+	int start;  // where the goal moves start in the journal
 	enum strat strat;
 	int a;
 	int b;
+
+	// Candidates of the strategy (columns, freecells, suits...) set up
+	// once when it starts on the goal, ncand is -1 until then
+	int8_t cand[12];
+	int8_t ncand;
 } Goal;
 
 bool respect_rule_of_two(Board *board, Card fromcard);
+bool is_safe_home(Board *board, Card fromcard);
+int autoplay(Board *board, Journal *journal);
 int comp_buildfactor(const void *p1, const void *p2, const void *arg);
 int comp_highest_sorted_card(const void *p1, const void *p2, const void *arg);
 int comp_fdlen(const void *p1, const void *p2, const void *arg);
 int comp_collen(const void *p1, const void *p2, const void *arg);
 
+void strat_init(Goal *goal, enum strat strat);
+enum strat strat_next(Board *board, Goal *goal);
+
+void strat_auto_win(Board *board, Goal *goal);
+void strat_endgame(Board *board, Goal *goal);
 void strat_rule_of_two(Board *board, Goal *goal);
 void strat_build_down(Board *board, Goal *goal);
 void strat_build_empty(Board *board, Goal *goal);
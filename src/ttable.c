@@ -0,0 +1,65 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "ttable.h"
+
+/**
+ * Allocate a new table of at least capacity entries, the number of
+ * buckets is rounded up to a power of two.
+ */
+void ttable_new(TTable **table, size_t capacity) {
+	size_t size;
+
+	for (size = 1; size * TTABLE_WAYS < capacity; size <<= 1);
+
+	*table = (TTable*)malloc(sizeof(TTable));
+	assert(*table != NULL);
+	(*table)->entries = (TEntry*)calloc(size * TTABLE_WAYS, sizeof(TEntry));
+	assert((*table)->entries != NULL);
+	(*table)->mask = size - 1;
+}
+
+void ttable_destroy(TTable *table) {
+	free(table->entries);
+	free(table);
+}
+
+/**
+ * Find the entry of a fingerprint, NULL when it is not in the table.
+ */
+TEntry* ttable_probe(TTable *table, uint64_t fingerprint) {
+	int way;
+	TEntry *bucket;
+
+	bucket = &table->entries[(fingerprint & table->mask) * TTABLE_WAYS];
+	for (way = 0; way < TTABLE_WAYS; way++) {
+		if (bucket[way].fingerprint == fingerprint && bucket[way].bound)
+			return &bucket[way];
+	}
+	return NULL;
+}
+
+/**
+ * Save a fingerprint, replacing its previous entry or the least useful
+ * one of its bucket. The bound must be positive, 0 marks empty entries.
+ */
+void ttable_store(TTable *table, uint64_t fingerprint, int g, int bound) {
+	int way;
+	TEntry *bucket, *entry;
+
+	assert(bound > 0);
+	bucket = &table->entries[(fingerprint & table->mask) * TTABLE_WAYS];
+	entry = &bucket[0];
+	for (way = 0; way < TTABLE_WAYS; way++) {
+		if (bucket[way].fingerprint == fingerprint) {
+			entry = &bucket[way];
+			break;
+		}
+		if (bucket[way].bound < entry->bound
+				|| (bucket[way].bound == entry->bound && bucket[way].g > entry->g))
+			entry = &bucket[way];
+	}
+
+	entry->fingerprint = fingerprint;
+	entry->g = g;
+	entry->bound = bound;
+}
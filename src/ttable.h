@@ -0,0 +1,38 @@
+#ifndef FREECELL_TTABLE_H
+#define FREECELL_TTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TTABLE_WAYS 4
+
+// Entries of the engines' tables, 16MB
+#define TTABLE_DEFAULT_SIZE (1 << 20)
+
+/**
+ * What is known about a board: the lowest number of moves it was reached
+ * with and the bound of the iteration that explored it.
+ */
+typedef struct tentry {
+	uint64_t fingerprint;
+	uint16_t g;
+	uint16_t bound;
+} TEntry;
+
+/**
+ * Fixed-size transposition table, a fingerprint can be in any of the
+ * TTABLE_WAYS entries of its bucket. When the bucket is full, the entry
+ * of the oldest iteration, then the deepest one, is replaced.
+ */
+typedef struct ttable {
+	TEntry *entries;
+	size_t mask;  // buckets - 1
+} TTable;
+
+void ttable_new(TTable **table, size_t capacity);
+void ttable_destroy(TTable *table);
+
+TEntry* ttable_probe(TTable *table, uint64_t fingerprint);
+void ttable_store(TTable *table, uint64_t fingerprint, int g, int bound);
+
+#endif